@@ -0,0 +1,39 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADVERTISE_H
+#define ADVERTISE_H
+
+#include <zephyr/types.h>
+
+#define BT_DEVICE_CYCLING_APPEARANCE 0x012
+
+// Bonded peers only, before opening up to new centrals
+#define ADV_ACCEPT_LIST_MS 5000U
+#define ADV_RETRY_MS 500U
+
+typedef enum
+{
+    ADV_DIRECTED,     // High duty directed to the last bonded central
+    ADV_ACCEPT_LIST,  // Undirected, connections from bonded peers only
+    ADV_OPEN,         // Undirected, anyone can connect
+} adv_mode_t;
+
+void advertiseStart();
+
+#endif  // ADVERTISE_H
@@ -35,6 +35,32 @@
 #define INIT_INC 0x0014
 #define INIT_RES 0x003A
 
+// Simulation target arbitration defaults.  A target moves the bike only
+// once it is more than half a step plus the deadband from the current
+// setting, so noise around a rounding boundary doesn't toggle the motor,
+// and issued changes are no closer together than the minimum interval.
+// Explicit targets skip both.  Half a step plus the deadband is kept
+// under a full step so a target one step away still moves the bike.
+#define INC_TGT_HALF_STEP 25         // 0.01%, bike steps are 50
+#define INC_TGT_DEADBAND 15
+#define INC_TGT_MIN_INTERVAL_MS 2000U
+#define RES_TGT_HALF_STEP 5          // 0.5%, bike steps are ~9.5
+#define RES_TGT_DEADBAND 2
+#define RES_TGT_MIN_INTERVAL_MS 1000U
+
+// ERG mode steps resistance when power is outside this band of the target
+#define ERG_BAND_PCT 5
+
+// Control loop period
+#define POLL_MS_DEFAULT 500
+#define POLL_MS_MIN 100
+#define POLL_MS_MAX 2000
+
+// Power calibration, watts = curve * scale / 100 + offset
+#define WATTS_SCALE_MIN_PCT 50
+#define WATTS_SCALE_MAX_PCT 200
+#define WATTS_OFFSET_MAX 100
+
 typedef enum
 {
     DECREASE,
@@ -42,6 +68,43 @@ typedef enum
     INCREASE
 } buttonStatus_t;
 
+typedef enum
+{
+    TGT_INCLINE,
+    TGT_RESISTANCE,
+    TGT_ACTUATOR_CNT
+} tgt_actuator_t;
+
+typedef struct
+{
+    uint32_t received;  // Targets received from clients
+    uint32_t issued;    // Targets forwarded to the bike
+} tgt_stats_t;
+
+// Tunable at runtime, see bikeMgmt.c
+typedef struct
+{
+    uint16_t poll_ms;
+    int16_t wattsOffset;
+    uint16_t wattsScale_pct;
+    uint16_t deadband [TGT_ACTUATOR_CNT];
+    uint32_t minInterval_ms [TGT_ACTUATOR_CNT];
+} bike_params_t;
+
+// Live state for diagnostics
+typedef struct
+{
+    uint16_t act_rpm;
+    uint16_t act_inc;   // Incline node reading
+    uint16_t set_inc;   // Incline node target
+    uint16_t set_res;   // Resistance node magnitude
+    uint16_t disp_res;
+    uint16_t watts;
+    uint16_t ergWatts;  // TGT_PWR_INVALID when ERG is off
+    int16_t held [TGT_ACTUATOR_CNT];
+    tgt_stats_t stats [TGT_ACTUATOR_CNT];
+} bike_diag_t;
+
 // Defined in main.c
 typedef int ( *send_msg_callback_t ) ( const cmd_msg_data_t );
 
@@ -51,9 +114,20 @@ buttonStatus_t evaluateButton ( int up, int down );
 void adjustIncline ( buttonStatus_t adj );
 void adjustResistance ( buttonStatus_t adj );
 void updateBikeTgts ( const bike_tgts_t tgts );  // set_targets_callback_t
+void setRiderIncline ( uint16_t tgt );
+void setRiderResistance ( uint16_t tgt );
 void initBike();
 int new_msg ( uint8_t *buff, size_t len );
 void updateBike();
+bool waitRiderInput ( uint32_t timeout_ms );
+void updateRiderTgts();
 bike_data_t getBikeData();
+void setTgtArbitration ( tgt_actuator_t act,
+                         uint16_t deadband,
+                         uint32_t minInterval_ms );
+tgt_stats_t getTgtStats ( tgt_actuator_t act );
+bike_params_t getBikeParams();
+int setBikeParams ( const bike_params_t *params );
+bike_diag_t getBikeDiag();
 
 #endif  // BIKE_CONTROL_H
\ No newline at end of file
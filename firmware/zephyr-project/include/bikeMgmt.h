@@ -0,0 +1,39 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BIKE_MGMT_H
+#define BIKE_MGMT_H
+
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt.h>
+#include <zephyr/types.h>
+
+// SMP group for field diagnostics and tuning
+#define BIKE_MGMT_GROUP_ID MGMT_GROUP_ID_PERUSER
+#define BIKE_MGMT_ID_STATE 0    // Read: live bike state
+#define BIKE_MGMT_ID_PARAMS 1   // Read/write: tunable parameters
+#define BIKE_MGMT_ID_LOG 2      // Read: drain dictionary log messages
+#define BIKE_MGMT_ID_PROFILE 3  // Read: section timing, write: reset
+#define BIKE_MGMT_ID_LV_POOL 4  // Read: LVGL pool use and high-water marks
+
+#define BIKE_MGMT_LOG_CHUNK 512
+
+#define BIKE_MGMT_SETTINGS_KEY "bike/params"
+
+void bikeMgmtLoopTime ( uint32_t exec_ms );
+
+#endif  // BIKE_MGMT_H
@@ -0,0 +1,40 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <zephyr/types.h>
+
+#define BROADCAST_COMPANY_ID 0xFFFF  // Reserved for internal use
+
+// Manufacturer specific data, little endian
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint16_t companyId;
+    uint16_t bikeId;
+    uint8_t seq;         // Increments every update
+    uint16_t watts;
+    uint8_t rpm;
+    uint8_t resistance;  // Display level
+    int16_t incline;     // 0.1%
+} broadcast_data_t;
+
+int broadcastStart();
+
+#endif  // BROADCAST_H
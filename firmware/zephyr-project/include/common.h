@@ -19,6 +19,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdbool.h>
 #include <zephyr/types.h>
 
 typedef struct
@@ -29,10 +30,16 @@ typedef struct
     uint16_t value;
 } cmd_msg_data_t;
 
+#define TGT_INC_INVALID 0x7FFF
+#define TGT_RES_INVALID 0xFF
+#define TGT_PWR_INVALID 0xFFFF
+
 typedef struct
 {
     int16_t incline;     // 0.01% - 0x7FFF invalid
     uint8_t resistance;  // 0.5% - 0xFF invalid
+    uint16_t power;      // watts - 0xFFFF invalid
+    bool sim;            // Simulation stream, deadbanded and rate limited
 } bike_tgts_t;
 typedef void ( *set_targets_callback_t ) ( const bike_tgts_t );
 
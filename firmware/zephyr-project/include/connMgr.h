@@ -0,0 +1,43 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONN_MGR_H
+#define CONN_MGR_H
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/types.h>
+
+// Short interval while a client is sending control point commands
+#define CONN_FAST_MIN_INT 6    // 7.5 ms
+#define CONN_FAST_MAX_INT 12   // 15 ms
+#define CONN_FAST_LATENCY 0
+#define CONN_FAST_TIMEOUT 400  // 4 s
+
+// Long interval with peripheral latency once the link goes quiet
+#define CONN_IDLE_MIN_INT 80   // 100 ms
+#define CONN_IDLE_MAX_INT 160  // 200 ms
+#define CONN_IDLE_LATENCY 4
+#define CONN_IDLE_TIMEOUT 600  // 6 s
+
+#define CONN_IDLE_AFTER_MS 10000U  // Relax after 10s without commands
+
+void connMgrConnected ( struct bt_conn *conn );
+void connMgrDisconnected ( struct bt_conn *conn );
+void connMgrControlActivity ( struct bt_conn *conn );
+
+#endif  // CONN_MGR_H
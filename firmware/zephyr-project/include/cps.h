@@ -46,6 +46,4 @@ typedef struct
     int16_t InstantaneousPower;  // Watts
 } ble_cps_measurement_data_t;
 
-int bt_cps_notify ( bike_data_t bikeData );
-
 #endif  // CPS_H
\ No newline at end of file
@@ -45,6 +45,4 @@ typedef struct __attribute__ ( ( __packed__ ) )
     uint16_t lastCrank_1024;
 } ble_cscs_measurement_data_t;
 
-int bt_cscs_bike_notify ( bike_data_t bikeData );
-
 #endif  // CSCS_H
\ No newline at end of file
@@ -36,8 +36,27 @@ typedef struct
     bool running;
 } stopwatch_data_t;
 
+// Last value rendered to each label
+typedef struct
+{
+    uint16_t act_rpm;
+    uint16_t watts;
+    uint16_t tgt_inc;
+    uint16_t disp_res;
+    uint32_t swSecs;
+    bool valid;  // Cleared to force every label to redraw
+} display_model_t;
+
+typedef struct
+{
+    uint32_t px_per_s;  // Invalidated pixels rendered and flushed
+    uint32_t spi_bytes_per_s;
+} display_stats_t;
+
 int initDisplay();
 int updateDisplay ( bike_data_t bikeData );
 void resetTime();
+void displayWake();
+display_stats_t getDisplayStats();
 
 #endif  // DISPLAY_H
\ No newline at end of file
@@ -0,0 +1,31 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISPLAY_FLUSH_H
+#define DISPLAY_FLUSH_H
+
+#include <lvgl.h>
+
+#define FLUSH_STACKSIZE 1024
+#define FLUSH_PRIORITY 13  // Above the display thread
+#define FLUSH_WAIT_MS 100U
+
+int displayFlushInit ( lv_disp_drv_t *drv );
+bool displayFlushIdle();
+
+#endif  // DISPLAY_FLUSH_H
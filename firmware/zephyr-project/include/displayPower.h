@@ -0,0 +1,37 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISPLAY_POWER_H
+#define DISPLAY_POWER_H
+
+#include <stdbool.h>
+#include <zephyr/device.h>
+#include <zephyr/types.h>
+
+typedef enum
+{
+    DISP_ACTIVE,
+    DISP_DIM,
+    DISP_ASLEEP,  // Backlight off, panel blanked, rendering paused
+    DISP_OFF,     // Panel controller in sleep mode as well
+} disp_power_t;
+
+int displayPowerInit ( const struct device *dev );
+disp_power_t displayPowerUpdate ( bool activity );
+
+#endif  // DISPLAY_POWER_H
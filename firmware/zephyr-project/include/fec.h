@@ -198,6 +198,5 @@ typedef struct __attribute__ ( ( __packed__ ) )
 
 // Functions
 void fecSetTargetsCb ( set_targets_callback_t func ); 
-void bt_fec_update ( bike_data_t data );
 
 #endif  // FEC_H
\ No newline at end of file
@@ -0,0 +1,29 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FEC_SCHEDULE_H
+#define FEC_SCHEDULE_H
+
+#include <zephyr/types.h>
+
+#define FEC_SCHEDULE_LEN 120  // Messages before the schedule repeats
+
+// Background page for message cnt, 0 to FEC_SCHEDULE_LEN - 1
+uint8_t fecScheduledPage ( uint16_t cnt );
+
+#endif  // FEC_SCHEDULE_H
@@ -19,6 +19,7 @@
 #ifndef FTMS_H
 #define FTMS_H
 
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/types.h>
 
 #include "common.h"
@@ -29,12 +30,36 @@
 #define OPCODE_SET_INC 0x03
 #define OPCODE_SET_RES 0x04
 #define OPCODE_START 0x07
+#define OPCODE_STOP 0x08
 #define OPCODE_SIM_PARAMS 0x11
 
 #define OPCODE_RESPONSE 0x80
-#define OPCODE_SUCCESS 0x01
 
-#define OPCODE_STARTED 0x04
+// 4.16.2.22 Result codes
+#define OPCODE_SUCCESS 0x01
+#define OPCODE_NOT_SUPPORTED 0x02
+#define OPCODE_INVALID_PARAM 0x03
+#define OPCODE_FAILED 0x04
+#define OPCODE_NOT_PERMITTED 0x05
+
+// 4.16.2.9 Stop or Pause Procedure
+#define STOP_PARAM_STOP 0x01
+#define STOP_PARAM_PAUSE 0x02
+
+// 4.17 Fitness Machine Status op codes
+#define STATUS_RESET 0x01
+#define STATUS_STOPPED 0x02
+#define STATUS_STARTED 0x04
+#define STATUS_TGT_INC 0x06
+#define STATUS_TGT_RES 0x07
+#define STATUS_SIM_PARAMS 0x12
+#define STATUS_PARAM_MAX 6
+
+// 4.10 Training Status
+#define TRAINING_STATUS_IDLE 0x01
+#define TRAINING_STATUS_MANUAL 0x0D  // Quick start
+
+#define FTMS_PAUSE_AFTER_MS 3000U  // Auto pause without cadence
 
 // Service UUID's
 #define BT_UUID_FTMS_VAL 0x1826
@@ -43,6 +68,7 @@
 // Characteristic UUID's
 #define BLE_UUID_FTMS_FEATURE_CHAR BT_UUID_DECLARE_16 ( 0x2ACC )
 #define BLE_UUID_INDOOR_BIKE_DATA_CHAR BT_UUID_DECLARE_16 ( 0x2AD2 )
+#define BLE_UUID_TRAINING_STATUS_CHAR BT_UUID_DECLARE_16 ( 0x2AD3 )
 #define BLUE_UUID_SUPPORTED_INCLINATION_RANGE_CHAR BT_UUID_DECLARE_16 ( 0x2AD5 )
 #define BLUE_UUID_SUPPORTED_RESISTANCE_RANGE_CHAR BT_UUID_DECLARE_16 ( 0x2AD6 )
 #define BLUE_UUID_FITNESS_CONTROL_POINT_CHAR BT_UUID_DECLARE_16 ( 0x2AD9 )
@@ -93,6 +119,9 @@ typedef struct __attribute__ ( ( __packed__ ) )
     uint8_t param [];
 } ctrl_point_req_t;
 
+// Largest control point write we accept (Set Indoor Bike Simulation is 7)
+#define CTRL_POINT_MAX_LEN 20
+
 // 4.16.2.18 Set Indoor Bike Simulation Parameters Procedure
 typedef struct __attribute__ ( ( __packed__ ) )
 {
@@ -120,16 +149,33 @@ typedef struct __attribute__ ( ( __packed__ ) )
     int16_t InstantaneousPower;     // watts
 } ble_ftms_indoor_bike_data_t;
 
+// 4.10 Training Status
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint8_t flags;
+    uint8_t status;
+} ble_ftms_training_status_t;
+
 // 4.17 Fitness Machine Status
-typedef struct ftms_status
+typedef struct __attribute__ ( ( __packed__ ) )
 {
     uint8_t op;
-    uint8_t param [];
+    uint8_t param [STATUS_PARAM_MAX];
 } ftms_status_t;
 
+typedef enum
+{
+    FTMS_IDLE,
+    FTMS_STARTED,
+    FTMS_PAUSED,
+    FTMS_STOPPED,
+} ftms_state_t;
+
+typedef void ( *ctrl_activity_callback_t ) ( struct bt_conn *conn );
+
 // Functions
 void ftmsSetTargetsCb ( set_targets_callback_t func ); 
-int bt_ftms_bike_notify ( bike_data_t bikeData );
-int bt_ftms_status_notify();
+void ftmsSetActivityCb ( ctrl_activity_callback_t func );
+void bt_ftms_status_update ( bike_data_t data );
 
 #endif  // FTMS_H
\ No newline at end of file
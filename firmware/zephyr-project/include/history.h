@@ -0,0 +1,92 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/types.h>
+
+#define HISTORY_PERIOD_MS 1000U
+#define HISTORY_BLOCK_SIZE 244  // One notification at ATT MTU 247
+#define HISTORY_BLOCKS 128      // ~2.5 hours at typical 3 bytes per sample
+#define HISTORY_STREAM_RETRY_MS 10
+
+// Service UUID's
+#define BT_UUID_HISTORY_VAL \
+    BT_UUID_128_ENCODE ( 0x7b1e0001, 0x5a7e, 0x4f3c, 0x9d2b, 0x2f8c6e1a0b30 )
+#define BT_UUID_HISTORY BT_UUID_DECLARE_128 ( BT_UUID_HISTORY_VAL )
+
+// Characteristic UUID's
+#define BLE_UUID_HISTORY_CONTROL_CHAR           \
+    BT_UUID_DECLARE_128 ( BT_UUID_128_ENCODE ( \
+        0x7b1e0002, 0x5a7e, 0x4f3c, 0x9d2b, 0x2f8c6e1a0b30 ) )
+#define BLE_UUID_HISTORY_DATA_CHAR              \
+    BT_UUID_DECLARE_128 ( BT_UUID_128_ENCODE ( \
+        0x7b1e0003, 0x5a7e, 0x4f3c, 0x9d2b, 0x2f8c6e1a0b30 ) )
+
+// Control point op codes
+#define HISTORY_OP_READ 0x01  // Stream blocks from a sequence number
+#define HISTORY_OP_ABORT 0x02
+
+// Delta record flags, a zigzag varint follows for each changed field
+#define HISTORY_WATTS_BIT BIT ( 0 )
+#define HISTORY_RPM_BIT BIT ( 1 )
+#define HISTORY_INC_BIT BIT ( 2 )
+#define HISTORY_RES_BIT BIT ( 3 )
+#define HISTORY_RECORD_MAX 12
+
+// One 1 Hz sample, also the first sample of every block
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint16_t watts;
+    uint8_t rpm;
+    uint8_t incline;  // Counts, see bike_data_t
+    uint8_t resistance;
+} history_sample_t;
+
+// Streamed as is, count of 0 marks the end of a read
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint32_t seq;    // Sequence number of the first sample
+    uint16_t count;  // Samples, including the first
+    uint16_t len;    // Bytes of delta records after the header
+    history_sample_t first;
+} history_block_hdr_t;
+
+typedef struct
+{
+    history_block_hdr_t hdr;
+    uint8_t data [HISTORY_BLOCK_SIZE - sizeof ( history_block_hdr_t )];
+} history_block_t;
+
+// Read from the control characteristic
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint32_t firstSeq;
+    uint32_t nextSeq;
+    uint16_t period_ms;
+} history_info_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint8_t op;
+    uint32_t seq;
+} history_req_t;
+
+#endif  // HISTORY_H
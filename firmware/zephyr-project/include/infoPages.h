@@ -0,0 +1,38 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INFO_PAGES_H
+#define INFO_PAGES_H
+
+#include <zephyr/types.h>
+
+#include "common.h"
+
+#define INFO_REFRESH_MS 1000U
+#define INFO_ROWS_Y 60
+#define INFO_SAMPLE_MAX_MS 2000U  // Longer gaps aren't counted as riding
+
+#define SETTINGS_ROW_H 60
+#define SETTINGS_OFFSET_STEP 5  // Watts
+#define SETTINGS_SCALE_STEP 2   // %
+
+// Workout totals, fed from the display thread with each new sample
+void summarySample ( bike_data_t data );
+void summaryReset();
+
+#endif  // INFO_PAGES_H
@@ -0,0 +1,32 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <zephyr/types.h>
+
+#define LOG_RING_SIZE 4096
+#define LOG_RING_OUT_SIZE 128
+#define LOG_RING_HDR_MAX 16  // Dictionary header on top of the message
+
+// Dictionary formatted log messages, decode with the build's
+// log_dictionary.json and Zephyr's scripts/logging/dictionary tools
+size_t logRingRead ( uint8_t *buf, size_t len, uint32_t *dropped );
+
+#endif  // LOG_RING_H
@@ -0,0 +1,49 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LV_POOL_H
+#define LV_POOL_H
+
+#include <zephyr/types.h>
+
+// Block counts are Kconfig, resize from the SMP high-water marks
+#define LV_POOL_CLASS_CNT 5
+#define LV_POOL_HDR_SIZE 8  // Size kept ahead of heap blocks, keeps alignment
+
+typedef struct
+{
+    uint16_t size;  // Block bytes
+    uint16_t blocks;
+    uint16_t used;
+    uint16_t peak;
+    uint32_t spills;  // Allocations passed on because the class was full
+} lv_pool_class_t;
+
+typedef struct
+{
+    lv_pool_class_t classes [LV_POOL_CLASS_CNT];
+    uint32_t heapUsed;  // Bytes requested from LVGL's heap, larger objects
+    uint32_t heapPeak;
+    uint32_t used;  // Bytes in use across blocks and heap
+    uint32_t peak;
+    uint32_t fails;  // Allocations LVGL got NULL for
+} lv_pool_stats_t;
+
+lv_pool_stats_t getLvPoolStats();
+
+#endif  // LV_POOL_H
@@ -0,0 +1,40 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUM_FMT_H
+#define NUM_FMT_H
+
+#include <zephyr/sys/util.h>
+#include <zephyr/types.h>
+
+#define NUM_FMT_MAX_DIGITS 10  // UINT32_MAX
+
+// Decimal formatting without printf.  Sizes include the terminator and
+// values that don't fit saturate to all nines instead of overflowing.
+size_t numFmtUint ( char *buf, size_t size, uint32_t value );
+size_t numFmtFixed ( char *buf, size_t size, int32_t value, uint8_t decimals );
+void numFmtPad ( char *buf, uint8_t width, uint32_t value );
+size_t numFmtIncline ( char *buf, size_t size, uint16_t counts );
+
+// Field width taken from the array, pointers don't compile
+#define NUM_FMT_UINT( _buf, _value ) \
+    numFmtUint ( _buf, ARRAY_SIZE ( _buf ), _value )
+#define NUM_FMT_FIXED( _buf, _value, _decimals ) \
+    numFmtFixed ( _buf, ARRAY_SIZE ( _buf ), _value, _decimals )
+
+#endif  // NUM_FMT_H
@@ -0,0 +1,45 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUM_LABEL_H
+#define NUM_LABEL_H
+
+#include <lvgl.h>
+#include <zephyr/types.h>
+
+#define NUM_LABEL_MAX_CELLS 8  // 00:00:00
+
+// Digits, '-', '.', '%' and ':' of Montserrat 48, built by CMake
+LV_FONT_DECLARE ( ubike_digits_48 );
+
+// Digits sit in fixed width cells so a changed digit only invalidates
+// its own cell, punctuation keeps its natural width
+typedef struct
+{
+    lv_obj_t *obj;
+    lv_coord_t digitW;
+    char text [NUM_LABEL_MAX_CELLS + 1];
+} num_label_t;
+
+void numLabelCreate ( num_label_t *label,
+                      lv_obj_t *parent,
+                      const lv_font_t *font,
+                      uint8_t cells );
+void numLabelSetText ( num_label_t *label, const char *text );
+
+#endif  // NUM_LABEL_H
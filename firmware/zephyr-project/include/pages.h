@@ -0,0 +1,69 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGES_H
+#define PAGES_H
+
+#include <lvgl.h>
+#include <zephyr/types.h>
+
+#include "common.h"
+
+#define PAGE_NAV_W 44
+#define PAGE_NAV_H 36
+
+typedef enum
+{
+    PAGE_MAIN,
+    PAGE_CONTROL,
+    PAGE_SUMMARY,
+    PAGE_DIAG,
+    PAGE_SETTINGS,
+    PAGE_CNT
+} page_id_t;
+
+// Static description of a page, the screen itself is built on first use
+typedef struct
+{
+    const char *title;  // Header text, NULL for none
+    void ( *create ) ( lv_obj_t *scr );
+    void ( *update ) ( const bike_data_t *data );  // Only while shown
+    bool resident;  // Kept when switched away from instead of freed
+} page_desc_t;
+
+typedef struct
+{
+    page_id_t active;
+    uint32_t heap_used;  // LVGL's heap, see lvPool.h
+    uint32_t heap_peak;
+} page_stats_t;
+
+// Defined by each page
+extern const page_desc_t mainPage;
+extern const page_desc_t controlPage;
+extern const page_desc_t summaryPage;
+extern const page_desc_t diagPage;
+extern const page_desc_t settingsPage;
+
+// Display thread only
+void pagesInit();
+void pageShow ( page_id_t id );
+void pagesUpdate ( const bike_data_t *data );
+page_stats_t getPageStats();
+
+#endif  // PAGES_H
@@ -0,0 +1,94 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/types.h>
+
+#if defined( CONFIG_CORTEX_M_DWT )
+#include <zephyr/arch/arm/aarch32/cortex_m/dwt.h>
+#endif
+
+#define PROFILE_BUCKETS 32  // Power of two cycle count histogram
+
+typedef enum
+{
+    PROF_CALC_WATTS,
+    PROF_CREATE_MSG,
+    PROF_NEW_MSG,
+    PROF_UPDATE_LABELS,
+    PROF_LV_TASK,
+    PROF_FLUSH,
+    PROF_PAGE_SWITCH,
+    PROF_RIDER_TO_BUS,
+    PROF_SECTION_CNT
+} profile_section_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;  // Cycles
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist [PROFILE_BUCKETS];
+} profile_stats_t;
+
+#if defined( CONFIG_UBIKE_PROFILE )
+
+typedef struct
+{
+    profile_section_t sec;
+    uint32_t start;
+} profile_scope_t;
+
+// Cycle counter, the kernel's when there is no DWT (native_posix)
+static inline uint32_t profileCycles()
+{
+#if defined( CONFIG_CORTEX_M_DWT )
+    return z_arm_dwt_get_cycles();
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+uint32_t profileCyclesPerSec();
+void profileSince ( profile_section_t sec, uint32_t start );
+void profileScopeEnd ( profile_scope_t *scope );
+void profileGet ( profile_section_t sec, profile_stats_t *stats );
+const char *profileName ( profile_section_t sec );
+uint32_t profilePercentile ( const profile_stats_t *stats, uint32_t pct );
+void profileReset();
+
+// Times the rest of the enclosing block, including early returns
+#define PROFILE_SCOPE( _sec )                                   \
+    profile_scope_t _profScope                                  \
+        __attribute__ ( ( cleanup ( profileScopeEnd ) ) )       \
+        = { _sec, profileCycles() }
+
+// For spans that start and end in different places or threads
+#define PROFILE_START() profileCycles()
+#define PROFILE_SINCE( _sec, _start ) profileSince ( _sec, _start )
+#else
+#define PROFILE_SCOPE( _sec )
+#define PROFILE_START() 0
+#define PROFILE_SINCE( _sec, _start )
+#endif
+
+#endif  // PROFILE_H
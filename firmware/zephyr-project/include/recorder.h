@@ -0,0 +1,171 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <zephyr/types.h>
+
+#define RECORDER_MNT "/lfs"
+#define RECORDER_INDEX RECORDER_MNT "/rides.txt"  // name,size per line
+#define RECORDER_NAME_MAX 32
+
+#define RECORDER_PERIOD_MS 1000U
+#define RECORDER_QUEUE_LEN 64      // Seconds buffered while flash is busy
+#define RECORDER_BUF_SIZE 512      // Write-behind buffer
+#define RECORDER_SYNC_S 30         // Worst case loss on power off
+#define RECORDER_IDLE_CLOSE_S 300  // Ride ends after 5 min without cadence
+#define RECORDER_MIN_FREE 32768    // Oldest rides are deleted below this
+#define RECORDER_STACKSIZE 2048
+#define RECORDER_PRIORITY 14
+
+// FIT protocol, see the FIT SDK "Flexible and Interoperable Data Transfer"
+#define FIT_PROTOCOL_VERSION 0x20
+#define FIT_PROFILE_VERSION 2132
+#define FIT_DEFINITION 0x40
+#define FIT_MANUFACTURER_DEVELOPMENT 255
+
+// Global message numbers
+#define FIT_MESG_FILE_ID 0
+#define FIT_MESG_SESSION 18
+#define FIT_MESG_LAP 19
+#define FIT_MESG_RECORD 20
+#define FIT_MESG_ACTIVITY 34
+
+// Local message types
+typedef enum
+{
+    FIT_LOCAL_FILE_ID,
+    FIT_LOCAL_RECORD,
+    FIT_LOCAL_LAP,
+    FIT_LOCAL_SESSION,
+    FIT_LOCAL_ACTIVITY,
+} fit_local_t;
+
+// Base types
+#define FIT_ENUM 0x00
+#define FIT_UINT8 0x02
+#define FIT_SINT16 0x83
+#define FIT_UINT16 0x84
+#define FIT_UINT32 0x86
+#define FIT_UINT32Z 0x8C
+
+// Enum values
+#define FIT_FILE_ACTIVITY 4
+#define FIT_SPORT_CYCLING 2
+#define FIT_SUB_SPORT_INDOOR_CYCLING 6
+#define FIT_EVENT_SESSION 8
+#define FIT_EVENT_LAP 9
+#define FIT_EVENT_ACTIVITY 26
+#define FIT_EVENT_TYPE_STOP 1
+#define FIT_ACTIVITY_MANUAL 0
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint8_t size;
+    uint8_t protocol;
+    uint16_t profile;
+    uint32_t dataSize;
+    uint8_t type [4];  // ".FIT"
+    uint16_t crc;
+} fit_header_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint8_t header;
+    uint8_t reserved;
+    uint8_t arch;  // 0 is little endian
+    uint16_t global;
+    uint8_t numFields;
+} fit_def_hdr_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint8_t num;
+    uint8_t size;
+    uint8_t type;
+} fit_field_def_t;
+
+// Timestamps below 0x10000000 are seconds since power up
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint8_t type;
+    uint16_t manufacturer;
+    uint16_t product;
+    uint32_t serial;
+    uint32_t timeCreated;
+} fit_file_id_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint32_t timestamp;
+    uint16_t power;
+    uint8_t cadence;
+    int16_t grade;  // 0.01%
+    uint8_t resistance;
+} fit_record_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint32_t timestamp;
+    uint32_t startTime;
+    uint32_t totalElapsed;  // ms
+    uint32_t totalTimer;    // ms
+    uint8_t event;
+    uint8_t eventType;
+} fit_lap_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint32_t timestamp;
+    uint32_t startTime;
+    uint32_t totalElapsed;  // ms
+    uint32_t totalTimer;    // ms
+    uint16_t numLaps;
+    uint16_t firstLapIndex;
+    uint16_t avgPower;
+    uint16_t maxPower;
+    uint8_t event;
+    uint8_t eventType;
+    uint8_t sport;
+    uint8_t subSport;
+    uint8_t avgCadence;
+    uint8_t maxCadence;
+} fit_session_t;
+
+typedef struct __attribute__ ( ( __packed__ ) )
+{
+    uint32_t timestamp;
+    uint32_t totalTimer;  // ms
+    uint16_t numSessions;
+    uint8_t type;
+    uint8_t event;
+    uint8_t eventType;
+} fit_activity_t;
+
+// Queued once a second from the sample timer
+typedef struct
+{
+    uint32_t time_s;
+    uint16_t watts;
+    uint8_t rpm;
+    uint8_t incline;  // Counts, see bike_data_t
+    uint8_t resistance;
+} recorder_sample_t;
+
+#endif  // RECORDER_H
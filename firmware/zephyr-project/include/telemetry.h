@@ -0,0 +1,60 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/types.h>
+
+#include "common.h"
+
+#define TELEMETRY_MAX_FRAMES 4
+#define TELEMETRY_FRAME_MAX 20
+#define TELEMETRY_MAX_INFLIGHT 1  // Per connection, per frame
+
+// Encodes a measurement payload into buf, returns its length
+typedef size_t ( *frame_encoder_t ) ( const bike_data_t *data, void *buf );
+
+// One cached payload per notifying characteristic
+typedef struct
+{
+    const struct bt_gatt_service_static *svc;
+    const struct bt_uuid *uuid;
+    frame_encoder_t encode;
+    const struct bt_gatt_attr *attr;
+    uint32_t seq;  // Sample the payload was encoded from
+    uint16_t len;
+    uint8_t buf [TELEMETRY_FRAME_MAX] __aligned ( 4 );
+    atomic_t inflight [CONFIG_BT_MAX_CONN];
+    uint32_t encoded;
+    uint32_t sent;
+    uint32_t dropped;  // Skipped because a link had not drained
+} telemetry_frame_t;
+
+#define TELEMETRY_FRAME_DEFINE( _name, _svc, _uuid, _encode ) \
+    static telemetry_frame_t _name                           \
+        = { .svc = &_svc, .uuid = _uuid, .encode = _encode }
+
+int telemetryRegister ( telemetry_frame_t *frame );
+void telemetryPublish ( bike_data_t data );
+uint32_t telemetryGetSample ( bike_data_t *data );
+
+#endif  // TELEMETRY_H
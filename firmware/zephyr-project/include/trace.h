@@ -0,0 +1,69 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <zephyr/toolchain.h>
+#include <zephyr/types.h>
+
+#define TRACE_SYNC 0xA5
+
+// Record types, fields a-d per type
+typedef enum
+{
+    TRACE_BUS_RX = 1,  // nodeId, funcCode, value, -
+    TRACE_BUS_ERR,     // error, -, -, -
+    TRACE_TGT_RX,      // incline, resistance, power, -
+    TRACE_TGT_ISSUED,  // actuator, target, received, issued
+    TRACE_NOTIFY,      // uuid, conn index, result, length
+    TRACE_LOOP,        // exec_ms, poll_ms, -, -
+    TRACE_RIDER_TGT,   // actuator, target, -, -
+    TRACE_BUS_TX,      // nodeId, funcCode, dataAddress, value
+} trace_type_t;
+
+// Fixed size binary record, see misc-scripts/trace-decode.py
+typedef struct __packed
+{
+    uint8_t sync;
+    uint8_t type;
+    uint16_t seq;  // Gaps are records skipped on overflow
+    uint32_t time_us;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    uint16_t d;
+} trace_rec_t;
+
+#if defined( CONFIG_UBIKE_TRACE )
+void traceRecord ( trace_type_t type,
+                   uint16_t a,
+                   uint16_t b,
+                   uint16_t c,
+                   uint16_t d );
+#else
+static inline void traceRecord ( trace_type_t type,
+                                 uint16_t a,
+                                 uint16_t b,
+                                 uint16_t c,
+                                 uint16_t d )
+{
+}
+#endif
+
+#endif  // TRACE_H
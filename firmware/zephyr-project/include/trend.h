@@ -0,0 +1,35 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREND_H
+#define TREND_H
+
+#include <lvgl.h>
+#include <zephyr/types.h>
+
+#include "common.h"
+
+#define TREND_PERIOD_MS 1000U  // One averaged point per second
+#define TREND_POINTS 300       // 5 minutes
+#define TREND_PWR_MAX 600      // Watts, primary axis
+#define TREND_RPM_MAX 150      // Cadence, secondary axis
+
+lv_obj_t *trendCreate ( lv_obj_t *parent, lv_coord_t w, lv_coord_t h );
+void trendSample ( bike_data_t data );
+
+#endif  // TREND_H
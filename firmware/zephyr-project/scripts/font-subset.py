@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+
+# Universal Bike Controller
+# Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import re
+import sys
+
+# Usage: font-subset.py <lv_font_xxx.c> <output.c> <font name> <characters>
+# Cuts an uncompressed LVGL 8 built-in font down to the listed characters
+# of its first (ASCII) range.  Kerning is dropped, the subset is meant
+# for fixed cell numeric widgets.
+
+def field ( text, name ):
+    match = re.search(r'\.' + name + r'\s*=\s*(-?\d+)', text)
+    if not match:
+        sys.exit('%s not found' % name)
+    return int(match.group(1))
+
+def parse ( text ):
+    if field(text, 'bitmap_format') != 0:
+        sys.exit('Compressed fonts are not supported')
+
+    # Bitmap bytes in order, comments stripped
+    body = re.search(r'glyph_bitmap\[\]\s*=\s*\{(.*?)\};', text, re.S).group(1)
+    body = re.sub(r'/\*.*?\*/', '', body, flags = re.S)
+    bitmap = [int(b, 16) for b in re.findall(r'0x[0-9a-fA-F]+', body)]
+
+    body = re.search(r'glyph_dsc\[\]\s*=\s*\{(.*?)\};', text, re.S).group(1)
+    dscs = []
+    for entry in re.findall(r'\{([^{}]*)\}', body):
+        dscs.append({k: int(v) for k, v in
+                     re.findall(r'\.(\w+)\s*=\s*(-?\d+)', entry)})
+
+    cmap = re.search(r'cmaps\[\]\s*=\s*\{(.*?)\};', text, re.S).group(1)
+    font = {
+        'bpp': field(text, 'bpp'),
+        'range_start': field(cmap, 'range_start'),
+        'range_length': field(cmap, 'range_length'),
+        'glyph_id_start': field(cmap, 'glyph_id_start'),
+        'line_height': field(text, 'line_height'),
+        'base_line': field(text, 'base_line'),
+        'underline_position': field(text, 'underline_position'),
+        'underline_thickness': field(text, 'underline_thickness'),
+    }
+    return font, bitmap, dscs
+
+def subset ( font, bitmap, dscs, chars ):
+    glyphs = []
+    for c in sorted(set(chars)):
+        offset = ord(c) - font['range_start']
+        if offset < 0 or offset >= font['range_length']:
+            sys.exit('%r is outside the first range' % c)
+        dsc = dict(dscs[font['glyph_id_start'] + offset])
+        size = (dsc['box_w'] * dsc['box_h'] * font['bpp'] + 7) // 8
+        start = dsc['bitmap_index']
+        glyphs.append((c, dsc, bitmap[start:start + size]))
+    return glyphs
+
+def emit ( font, glyphs, name ):
+    out = ['/* Generated by scripts/font-subset.py, do not edit */', '',
+           '#include <lvgl.h>', '',
+           'static LV_ATTRIBUTE_LARGE_CONST const uint8_t glyph_bitmap[] = {']
+    index = 0
+    dscLines = ['    {.bitmap_index = 0, .adv_w = 0, .box_w = 0, .box_h = 0, '
+                '.ofs_x = 0, .ofs_y = 0},']
+    for c, dsc, data in glyphs:
+        out.append('    /* U+%04X "%s" */' % (ord(c), c))
+        for i in range(0, len(data), 12):
+            out.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 12])
+                       + ',')
+        dscLines.append('    {.bitmap_index = %d, .adv_w = %d, .box_w = %d, '
+                        '.box_h = %d, .ofs_x = %d, .ofs_y = %d},' % (
+                            index, dsc['adv_w'], dsc['box_w'], dsc['box_h'],
+                            dsc['ofs_x'], dsc['ofs_y']))
+        index += len(data)
+    out += ['};', '',
+            'static const lv_font_fmt_txt_glyph_dsc_t glyph_dsc[] = {']
+    out += dscLines
+
+    first = ord(glyphs[0][0])
+    offsets = ', '.join('0x%x' % (ord(c) - first) for c, _, _ in glyphs)
+    out += ['};', '',
+            'static const uint16_t unicode_list_0[] = { %s };' % offsets, '',
+            'static const lv_font_fmt_txt_cmap_t cmaps[] = {',
+            '    {.range_start = %d, .range_length = %d, .glyph_id_start = 1,'
+            % (first, ord(glyphs[-1][0]) - first + 1),
+            '     .unicode_list = unicode_list_0, .glyph_id_ofs_list = NULL,',
+            '     .list_length = %d, .type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY}'
+            % len(glyphs),
+            '};', '',
+            'static lv_font_fmt_txt_glyph_cache_t cache;',
+            'static const lv_font_fmt_txt_dsc_t font_dsc = {',
+            '    .glyph_bitmap = glyph_bitmap,',
+            '    .glyph_dsc = glyph_dsc,',
+            '    .cmaps = cmaps,',
+            '    .kern_dsc = NULL,',
+            '    .kern_scale = 0,',
+            '    .cmap_num = 1,',
+            '    .bpp = %d,' % font['bpp'],
+            '    .kern_classes = 0,',
+            '    .bitmap_format = 0,',
+            '    .cache = &cache',
+            '};', '',
+            'const lv_font_t %s = {' % name,
+            '    .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,',
+            '    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,',
+            '    .line_height = %d,' % font['line_height'],
+            '    .base_line = %d,' % font['base_line'],
+            '    .subpx = LV_FONT_SUBPX_NONE,',
+            '    .underline_position = %d,' % font['underline_position'],
+            '    .underline_thickness = %d,' % font['underline_thickness'],
+            '    .dsc = &font_dsc',
+            '};', '']
+    return '\n'.join(out)
+
+if __name__ == '__main__':
+    source, output, name, chars = sys.argv[1:5]
+    with open(source) as f:
+        font, bitmap, dscs = parse(f.read())
+    glyphs = subset(font, bitmap, dscs, chars)
+    with open(output, 'w') as f:
+        f.write(emit(font, glyphs, name))
+
+    # Flash taken by bitmaps, the bulk of the saving, shows in the build log
+    kept = sum(len(data) for _, _, data in glyphs)
+    print('%s: %d of %d glyphs, %d of %d bitmap bytes' % (
+        name, len(glyphs), len(dscs) - 1, kept, len(bitmap)))
@@ -0,0 +1,255 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "advertise.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include "cps.h"
+#include "ftms.h"
+
+LOG_MODULE_REGISTER ( adv );
+
+#define DEVICE_NAME CONFIG_BT_DEVICE_NAME
+#define DEVICE_NAME_LEN ( sizeof ( DEVICE_NAME ) - 1 )
+
+#define ADV_PARAM_ACCEPT_LIST                                           \
+    BT_LE_ADV_PARAM ( BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME \
+                          | BT_LE_ADV_OPT_FILTER_CONN,                  \
+                      BT_GAP_ADV_FAST_INT_MIN_1,                        \
+                      BT_GAP_ADV_FAST_INT_MAX_1,                        \
+                      NULL )
+#define ADV_PARAM_OPEN                                                   \
+    BT_LE_ADV_PARAM ( BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME, \
+                      BT_GAP_ADV_FAST_INT_MIN_2,                         \
+                      BT_GAP_ADV_FAST_INT_MAX_2,                         \
+                      NULL )
+
+static const struct bt_data ad []
+    = { BT_DATA_BYTES ( BT_DATA_GAP_APPEARANCE,
+                        ( BT_DEVICE_CYCLING_APPEARANCE >> 0 ) & 0xff,
+                        ( BT_DEVICE_CYCLING_APPEARANCE >> 8 ) & 0xff ),
+        BT_DATA_BYTES ( BT_DATA_FLAGS,
+                        ( BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR ) ),
+        BT_DATA_BYTES ( BT_DATA_UUID16_ALL,
+                        BT_UUID_16_ENCODE ( BT_UUID_CPS_VAL ),
+                        BT_UUID_16_ENCODE ( BT_UUID_CSC_VAL ),
+                        BT_UUID_16_ENCODE ( BT_UUID_FTMS_VAL ) ),
+        BT_DATA ( BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN ) };
+
+static const struct bt_data sd [] = {
+    BT_DATA_BYTES ( BT_DATA_UUID128_ALL,
+                    0x84,
+                    0xaa,
+                    0x60,
+                    0x74,
+                    0x52,
+                    0x8a,
+                    0x8b,
+                    0x86,
+                    0xd3,
+                    0x4c,
+                    0xb7,
+                    0x1d,
+                    0x1d,
+                    0xdc,
+                    0x53,
+                    0x8d ),
+};
+
+static adv_mode_t advMode;
+static bt_addr_le_t lastPeer;
+static bool lastPeerValid = false;
+
+static void adv_work_handler ( struct k_work *work );
+static void peer_work_handler ( struct k_work *work );
+K_WORK_DELAYABLE_DEFINE ( adv_work, adv_work_handler );
+K_WORK_DEFINE ( peer_work, peer_work_handler );
+
+static void add_bond ( const struct bt_bond_info *info, void *user_data )
+{
+    int *count = user_data;
+    int err = bt_le_filter_accept_list_add ( &info->addr );
+    if ( err ) {
+        LOG_WRN ( "Failed to add bond to accept list: %d", err );
+        return;
+    }
+    ( *count )++;
+}
+
+static int start_directed()
+{
+    if ( !lastPeerValid
+         || !bt_addr_le_is_bonded ( BT_ID_DEFAULT, &lastPeer ) ) {
+        return -ENOENT;
+    }
+
+    // Times out after 1.28s with BT_HCI_ERR_ADV_TIMEOUT
+    return bt_le_adv_start (
+        BT_LE_ADV_CONN_DIR ( &lastPeer ), NULL, 0, NULL, 0 );
+}
+
+static int start_accept_list()
+{
+    int count = 0;
+    int err = bt_le_filter_accept_list_clear();
+    if ( err ) {
+        return err;
+    }
+    bt_foreach_bond ( BT_ID_DEFAULT, add_bond, &count );
+    if ( !count ) {
+        return -ENOENT;
+    }
+
+    return bt_le_adv_start ( ADV_PARAM_ACCEPT_LIST,
+                             ad,
+                             ARRAY_SIZE ( ad ),
+                             sd,
+                             ARRAY_SIZE ( sd ) );
+}
+
+static void adv_work_handler ( struct k_work *work )
+{
+    int err;
+
+    bt_le_adv_stop();
+    switch ( advMode ) {
+        case ADV_DIRECTED:
+            err = start_directed();
+            if ( err != -ENOENT ) {
+                break;
+            }
+            advMode = ADV_ACCEPT_LIST;
+            // Fall through
+        case ADV_ACCEPT_LIST:
+            err = start_accept_list();
+            if ( !err ) {
+                advMode = ADV_OPEN;
+                k_work_schedule ( &adv_work, K_MSEC ( ADV_ACCEPT_LIST_MS ) );
+                LOG_INF ( "Advertising to bonded peers" );
+                return;
+            }
+            if ( err != -ENOENT ) {
+                break;
+            }
+            advMode = ADV_OPEN;
+            // Fall through
+        case ADV_OPEN:
+            err = bt_le_adv_start ( ADV_PARAM_OPEN,
+                                    ad,
+                                    ARRAY_SIZE ( ad ),
+                                    sd,
+                                    ARRAY_SIZE ( sd ) );
+            break;
+        default:
+            return;
+    }
+
+    if ( err ) {
+        // Connection object may not be released yet after a disconnect
+        LOG_WRN ( "Advertising failed to start (err %d), retrying", err );
+        k_work_schedule ( &adv_work, K_MSEC ( ADV_RETRY_MS ) );
+        return;
+    }
+
+    LOG_INF ( "Advertising successfully started (mode %d)", advMode );
+}
+
+static void peer_work_handler ( struct k_work *work )
+{
+    int err = settings_save_one ( "adv/peer", &lastPeer, sizeof ( lastPeer ) );
+    if ( err ) {
+        LOG_ERR ( "Failed to save last peer: %d", err );
+    }
+}
+
+static int adv_settings_set ( const char *name,
+                              size_t len,
+                              settings_read_cb read_cb,
+                              void *cb_arg )
+{
+    if ( strcmp ( name, "peer" ) ) {
+        return -ENOENT;
+    }
+    if ( len != sizeof ( lastPeer ) ) {
+        return -EINVAL;
+    }
+
+    int rc = read_cb ( cb_arg, &lastPeer, sizeof ( lastPeer ) );
+    if ( rc < 0 ) {
+        return rc;
+    }
+    lastPeerValid = true;
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE (
+    adv, "adv", NULL, adv_settings_set, NULL, NULL );
+
+void advertiseStart()
+{
+    advMode = ADV_DIRECTED;
+    k_work_reschedule ( &adv_work, K_NO_WAIT );
+}
+
+static void connected ( struct bt_conn *conn, uint8_t err )
+{
+    if ( err == BT_HCI_ERR_ADV_TIMEOUT && advMode == ADV_DIRECTED ) {
+        LOG_INF ( "Directed advertising timed out" );
+        advMode = ADV_ACCEPT_LIST;
+        k_work_reschedule ( &adv_work, K_NO_WAIT );
+        return;
+    }
+    if ( !err ) {
+        k_work_cancel_delayable ( &adv_work );
+    }
+}
+
+static void disconnected ( struct bt_conn *conn, uint8_t reason )
+{
+    advertiseStart();
+}
+
+static void security_changed ( struct bt_conn *conn,
+                               bt_security_t level,
+                               enum bt_security_err err )
+{
+    const bt_addr_le_t *dst = bt_conn_get_dst ( conn );
+    if ( err || !bt_addr_le_is_bonded ( BT_ID_DEFAULT, dst ) ) {
+        return;
+    }
+    if ( lastPeerValid && !bt_addr_le_cmp ( dst, &lastPeer ) ) {
+        return;
+    }
+
+    bt_addr_le_copy ( &lastPeer, dst );
+    lastPeerValid = true;
+    k_work_submit ( &peer_work );
+}
+
+BT_CONN_CB_DEFINE ( adv_callbacks )
+    = { .connected = connected,
+        .disconnected = disconnected,
+        .security_changed = security_changed };
@@ -22,6 +22,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "profile.h"
+
 static const char *asciiLookup [256]
     = { "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "0A", "0B",
         "0C", "0D", "0E", "0F", "10", "11", "12", "13", "14", "15", "16", "17",
@@ -73,6 +75,7 @@ uint8_t calc_checksum ( uint8_t *buff, size_t len )
 
 size_t create_msg ( char *buff, cmd_msg_data_t data )
 {
+    PROFILE_SCOPE ( PROF_CREATE_MSG );
     buff [0] = START;
     buff [1] = asciiLookup [data.nodeId][0];
     buff [2] = asciiLookup [data.nodeId][1];
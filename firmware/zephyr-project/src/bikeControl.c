@@ -18,11 +18,15 @@
 
 #include "bikeControl.h"
 
+#include <errno.h>
 #include <math.h>
+#include <stdlib.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/kernel.h>
 
 #include "asciiModbus.h"
+#include "profile.h"
+#include "trace.h"
 
 LOG_MODULE_REGISTER ( bike );
 static send_msg_callback_t sendMsgCbFunc = NULL;
@@ -45,8 +49,49 @@ static cmd_msg_data_t ZERO_RPM
 static uint16_t act_rpm = 0;
 static uint16_t act_inc = INIT_INC;
 static uint16_t disp_res = 1;
+static uint16_t watts = 0;
 static bool firstRead = false;
 
+// Runtime tunables
+static uint16_t poll_ms = POLL_MS_DEFAULT;
+static int16_t wattsOffset = 0;
+static uint16_t wattsScale_pct = 100;
+
+// Targets from BLE clients, latched here and applied by updateBike()
+static struct k_spinlock tgtsLock;
+static bike_tgts_t pendingTgts
+    = { TGT_INC_INVALID, TGT_RES_INVALID, TGT_PWR_INVALID };
+static bool pendingSim [TGT_ACTUATOR_CNT];    // Per target, see arbitrate()
+static uint16_t ergWatts = TGT_PWR_INVALID;  // ERG mode off when invalid
+
+// Rider input wakes the control loop early, start is kept for latency
+K_SEM_DEFINE ( rider_sem, 0, 1 );
+static atomic_t riderPending = ATOMIC_INIT ( 0 );
+static uint32_t riderStart = 0;
+
+// Per actuator target arbitration
+typedef struct
+{
+    uint16_t halfStep;  // Half a bike step in client units
+    uint16_t deadband;
+    uint32_t minInterval_ms;
+    int16_t held;     // Last target forwarded
+    int16_t pending;  // Target waiting out the rate limit
+    bool valid;
+    bool hasPending;
+    bool pendingSim;
+    uint32_t lastIssued_ms;
+    tgt_stats_t stats;
+} tgt_arbiter_t;
+
+static tgt_arbiter_t arbiters [TGT_ACTUATOR_CNT]
+    = { { .halfStep = INC_TGT_HALF_STEP,
+          .deadband = INC_TGT_DEADBAND,
+          .minInterval_ms = INC_TGT_MIN_INTERVAL_MS },
+        { .halfStep = RES_TGT_HALF_STEP,
+          .deadband = RES_TGT_DEADBAND,
+          .minInterval_ms = RES_TGT_MIN_INTERVAL_MS } };
+
 void setSendMsgCb ( send_msg_callback_t func )
 {
     sendMsgCbFunc = func;
@@ -55,6 +100,11 @@ void setSendMsgCb ( send_msg_callback_t func )
 void sendWithRetries ( cmd_msg_data_t cmd, uint16_t retries, int32_t delay_ms )
 {
     int res;
+    traceRecord ( TRACE_BUS_TX,
+                  cmd.nodeId,
+                  cmd.funcCode,
+                  cmd.dataAddress,
+                  cmd.value );
     for ( int i = 0; i < retries + 1; i++ ) {
         res = sendMsgCbFunc ( cmd );
         if ( !res ) {
@@ -99,6 +149,76 @@ static uint16_t calc_res()
     return res;
 }
 
+// Client units to bike steps and back, incline is 0.01% against counts
+// of 0.5% from -10%, resistance 0.5% against display levels 1-22
+static uint16_t inc_to_bike ( int16_t tgt )
+{
+    if ( tgt >= 2000 ) {
+        return 60;
+    } else if ( tgt <= -1000 ) {
+        return 0;
+    }
+    uint16_t roundUp = ( tgt + 1000 ) % 50 > 25 ? 1 : 0;
+    return ( tgt + 1000 ) / 50 + roundUp;
+}
+
+static int16_t inc_from_bike ( uint16_t counts )
+{
+    return counts * 50 - 1000;
+}
+
+static uint16_t res_to_bike ( int16_t tgt )
+{
+    if ( tgt >= 200 ) {
+        return 22;
+    } else if ( tgt <= 0 ) {
+        return 1;
+    }
+    return 1 + ( tgt * 21 + 100 ) / 200;
+}
+
+static int16_t res_from_bike ( uint16_t level )
+{
+    return ( level - 1 ) * 200 / 21;
+}
+
+// Handlebar buttons and touch controls, safe from ISRs
+static void rider_input ( tgt_actuator_t act, uint16_t tgt )
+{
+    if ( atomic_cas ( &riderPending, 0, 1 ) ) {
+        riderStart = PROFILE_START();
+    }
+
+    // Rider wins over anything a client has waiting, and later client
+    // targets are arbitrated against what the rider set
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    tgt_arbiter_t *arb = &arbiters [act];
+    if ( act == TGT_INCLINE ) {
+        pendingTgts.incline = TGT_INC_INVALID;
+        arb->held = inc_from_bike ( tgt );
+    } else {
+        pendingTgts.resistance = TGT_RES_INVALID;
+        pendingTgts.power = TGT_PWR_INVALID;
+        arb->held = res_from_bike ( tgt );
+    }
+    arb->valid = true;
+    arb->hasPending = false;
+    arb->lastIssued_ms = k_uptime_get_32();
+    k_spin_unlock ( &tgtsLock, key );
+
+    traceRecord ( TRACE_RIDER_TGT, act, tgt, 0, 0 );
+    k_sem_give ( &rider_sem );
+}
+
+// Closes the latency span once the input's bus write has gone out
+static void rider_written ( bool wrote )
+{
+    if ( atomic_clear ( &riderPending ) && wrote ) {
+        PROFILE_SINCE ( PROF_RIDER_TO_BUS, riderStart );
+    }
+}
+
+// Bounces and both buttons held come in as NOTHING, and are ignored
 void adjustIncline ( buttonStatus_t adj )
 {
     if ( ( adj == INCREASE ) && ( SET_INC.value < 60 ) ) {
@@ -107,10 +227,13 @@ void adjustIncline ( buttonStatus_t adj )
     } else if ( ( adj == DECREASE ) && ( SET_INC.value > 0 ) ) {
         SET_INC.value--;
         LOG_INF ( "Decreasing incline to: %d", SET_INC.value );
+    } else {
+        return;
     }
+    rider_input ( TGT_INCLINE, SET_INC.value );
 }
 
-void adjustResistance ( buttonStatus_t adj )
+static void stepResistance ( buttonStatus_t adj )
 {
     if ( ( adj == INCREASE ) && ( disp_res < 22 ) ) {
         disp_res++;
@@ -121,6 +244,19 @@ void adjustResistance ( buttonStatus_t adj )
     }
 }
 
+void adjustResistance ( buttonStatus_t adj )
+{
+    const uint16_t prev = disp_res;
+    stepResistance ( adj );
+    if ( disp_res == prev ) {
+        return;
+    }
+
+    // Rider taking over resistance ends ERG mode
+    ergWatts = TGT_PWR_INVALID;
+    rider_input ( TGT_RESISTANCE, disp_res );
+}
+
 static void setIncline ( uint16_t tgt )
 {
     LOG_INF ( "Setting incline to: %u", tgt );
@@ -135,40 +271,214 @@ static void setResistance ( uint16_t tgt )
 {
     LOG_INF ( "Setting resistance to: %u", tgt );
     if ( tgt > 22 ) {
-        SET_INC.value = 22;
+        disp_res = 22;
     } else if ( tgt <= 1 ) {
-        SET_INC.value = 1;
+        disp_res = 1;
     } else {
-        SET_INC.value = tgt;
+        disp_res = tgt;
     }
 }
 
-// Update bike targets
+// Absolute rider targets, e.g. from a slider
+void setRiderIncline ( uint16_t tgt )
+{
+    setIncline ( tgt );
+    rider_input ( TGT_INCLINE, SET_INC.value );
+}
+
+void setRiderResistance ( uint16_t tgt )
+{
+    ergWatts = TGT_PWR_INVALID;
+    setResistance ( tgt );
+    rider_input ( TGT_RESISTANCE, disp_res );
+}
+
+// Update bike targets, safe to call from any thread
 void updateBikeTgts ( const bike_tgts_t tgts )
 {
-    // Incline
-    if ( tgts.incline != 0x7FFF ) {
-        if ( tgts.incline >= 2000 ) {
-            setIncline ( 60 );
-        } else if ( tgts.incline <= -1000 ) {
-            setIncline ( 0 );
-        } else {
-            uint16_t roundUp = ( tgts.incline + 1000 ) % 50 > 25 ? 1 : 0;
-            setIncline ( ( tgts.incline + 1000 ) / 50 + roundUp );
-        }
+    // Bursts between updates coalesce, only the latest target is kept
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    if ( tgts.incline != TGT_INC_INVALID ) {
+        pendingTgts.incline = tgts.incline;
+        pendingSim [TGT_INCLINE] = tgts.sim;
+        arbiters [TGT_INCLINE].stats.received++;
+    }
+    if ( tgts.resistance != TGT_RES_INVALID ) {
+        pendingTgts.resistance = tgts.resistance;
+        pendingTgts.power = TGT_PWR_INVALID;
+        pendingSim [TGT_RESISTANCE] = tgts.sim;
+        arbiters [TGT_RESISTANCE].stats.received++;
     }
+    if ( tgts.power != TGT_PWR_INVALID ) {
+        pendingTgts.power = tgts.power;
+        pendingTgts.resistance = TGT_RES_INVALID;
+    }
+    k_spin_unlock ( &tgtsLock, key );
+    traceRecord ( TRACE_TGT_RX, tgts.incline, tgts.resistance, tgts.power, 0 );
+}
 
-    // Resistance
-    if ( tgts.resistance != 0xFF ) {
-        if ( tgts.resistance >= 200 ) {
-            setResistance ( 22 );
-        } else if ( tgts.resistance == 0 ) {
-            setResistance ( 1 );
+void setTgtArbitration ( tgt_actuator_t act,
+                         uint16_t deadband,
+                         uint32_t minInterval_ms )
+{
+    if ( act >= TGT_ACTUATOR_CNT ) {
+        return;
+    }
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    arbiters [act].deadband = deadband;
+    arbiters [act].minInterval_ms = minInterval_ms;
+    k_spin_unlock ( &tgtsLock, key );
+}
+
+tgt_stats_t getTgtStats ( tgt_actuator_t act )
+{
+    tgt_stats_t stats = {};
+    if ( act >= TGT_ACTUATOR_CNT ) {
+        return stats;
+    }
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    stats = arbiters [act].stats;
+    k_spin_unlock ( &tgtsLock, key );
+    return stats;
+}
+
+bike_params_t getBikeParams()
+{
+    bike_params_t params;
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    params.poll_ms = poll_ms;
+    params.wattsOffset = wattsOffset;
+    params.wattsScale_pct = wattsScale_pct;
+    for ( int i = 0; i < TGT_ACTUATOR_CNT; i++ ) {
+        params.deadband [i] = arbiters [i].deadband;
+        params.minInterval_ms [i] = arbiters [i].minInterval_ms;
+    }
+    k_spin_unlock ( &tgtsLock, key );
+    return params;
+}
+
+int setBikeParams ( const bike_params_t *params )
+{
+    if ( params->poll_ms < POLL_MS_MIN || params->poll_ms > POLL_MS_MAX
+         || params->wattsScale_pct < WATTS_SCALE_MIN_PCT
+         || params->wattsScale_pct > WATTS_SCALE_MAX_PCT
+         || abs ( params->wattsOffset ) > WATTS_OFFSET_MAX ) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    poll_ms = params->poll_ms;
+    wattsOffset = params->wattsOffset;
+    wattsScale_pct = params->wattsScale_pct;
+    for ( int i = 0; i < TGT_ACTUATOR_CNT; i++ ) {
+        arbiters [i].deadband = params->deadband [i];
+        arbiters [i].minInterval_ms = params->minInterval_ms [i];
+    }
+    k_spin_unlock ( &tgtsLock, key );
+    LOG_INF ( "Parameters updated, poll %u ms", params->poll_ms );
+    return 0;
+}
+
+bike_diag_t getBikeDiag()
+{
+    bike_diag_t diag = { .act_rpm = act_rpm,
+                         .act_inc = act_inc,
+                         .set_inc = SET_INC.value,
+                         .set_res = SET_RES.value,
+                         .disp_res = disp_res,
+                         .watts = watts,
+                         .ergWatts = ergWatts };
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    for ( int i = 0; i < TGT_ACTUATOR_CNT; i++ ) {
+        diag.held [i] = arbiters [i].held;
+        diag.stats [i] = arbiters [i].stats;
+    }
+    k_spin_unlock ( &tgtsLock, key );
+    return diag;
+}
+
+// Returns true when a new target should be forwarded to the bike.  Targets
+// are compared with what the bike is set to, including rider changes,
+// both in client units.  Caller holds tgtsLock.
+static bool arbitrate ( tgt_arbiter_t *arb,
+                        bool received,
+                        int16_t tgt,
+                        int16_t applied,
+                        bool sim )
+{
+    if ( received ) {
+        if ( !sim || abs ( tgt - applied ) > arb->halfStep + arb->deadband ) {
+            arb->pending = tgt;
+            arb->hasPending = true;
+            arb->pendingSim = sim;
         } else {
-            uint16_t roundUp = ( tgts.resistance * 21 ) % 200 > 25 ? 1 : 0;
-            setResistance ( 1 + ( tgts.resistance * 21 ) / 200 + roundUp );
+            // Bike is already there, drop anything still waiting
+            arb->hasPending = false;
         }
     }
+    if ( !arb->hasPending ) {
+        return false;
+    }
+
+    const uint32_t now_ms = k_uptime_get_32();
+    if ( arb->pendingSim && arb->valid
+         && ( now_ms - arb->lastIssued_ms < arb->minInterval_ms ) ) {
+        return false;
+    }
+    arb->held = arb->pending;
+    arb->valid = true;
+    arb->hasPending = false;
+    arb->lastIssued_ms = now_ms;
+    arb->stats.issued++;
+    return true;
+}
+
+static void log_issued ( tgt_actuator_t act, int16_t held, tgt_stats_t stats )
+{
+    traceRecord ( TRACE_TGT_ISSUED, act, held, stats.received, stats.issued );
+    LOG_INF ( "Target %d forwarded, %u received / %u issued",
+              held,
+              stats.received,
+              stats.issued );
+}
+
+static void applyBikeTgts()
+{
+    k_spinlock_key_t key = k_spin_lock ( &tgtsLock );
+    bike_tgts_t tgts = pendingTgts;
+    pendingTgts.incline = TGT_INC_INVALID;
+    pendingTgts.resistance = TGT_RES_INVALID;
+    pendingTgts.power = TGT_PWR_INVALID;
+    if ( tgts.power != TGT_PWR_INVALID ) {
+        ergWatts = tgts.power;
+    } else if ( tgts.resistance != TGT_RES_INVALID ) {
+        ergWatts = TGT_PWR_INVALID;
+    }
+    const bool newInc = arbitrate ( &arbiters [TGT_INCLINE],
+                                    tgts.incline != TGT_INC_INVALID,
+                                    tgts.incline,
+                                    inc_from_bike ( SET_INC.value ),
+                                    pendingSim [TGT_INCLINE] );
+    const bool newRes = arbitrate ( &arbiters [TGT_RESISTANCE],
+                                    tgts.resistance != TGT_RES_INVALID,
+                                    tgts.resistance,
+                                    res_from_bike ( disp_res ),
+                                    pendingSim [TGT_RESISTANCE] );
+    tgts.incline = arbiters [TGT_INCLINE].held;
+    tgts.resistance = arbiters [TGT_RESISTANCE].held;
+    const tgt_stats_t incStats = arbiters [TGT_INCLINE].stats;
+    const tgt_stats_t resStats = arbiters [TGT_RESISTANCE].stats;
+    k_spin_unlock ( &tgtsLock, key );
+
+    // Logged once the lock is released, it masks interrupts
+    if ( newInc ) {
+        log_issued ( TGT_INCLINE, tgts.incline, incStats );
+        setIncline ( inc_to_bike ( tgts.incline ) );
+    }
+    if ( newRes ) {
+        log_issued ( TGT_RESISTANCE, tgts.resistance, resStats );
+        setResistance ( res_to_bike ( tgts.resistance ) );
+    }
 }
 
 void initBike()
@@ -190,6 +500,7 @@ void initBike()
 
 int new_msg ( uint8_t *buff, size_t len )
 {
+    PROFILE_SCOPE ( PROF_NEW_MSG );
     convert_8N1to_7N2 ( buff, len );
     // Remove start
     if ( buff [0] != ':' ) {
@@ -212,10 +523,12 @@ int new_msg ( uint8_t *buff, size_t len )
     uint8_t funcCode = ascii_to_int_2 ( buff + 2 );
     if ( funcCode == WRITE_HOLD ) {
         // Assume a succesful write
+        traceRecord ( TRACE_BUS_RX, nodeId, funcCode, 0, 0 );
         return 0;
     } else if ( funcCode == READ_MULTI_HOLD ) {
         //  This is a reply, we need to extract data
         uint16_t value = ascii_to_int_4 ( buff + 10 );
+        traceRecord ( TRACE_BUS_RX, nodeId, funcCode, value, 0 );
         if ( nodeId == RPM_NODE ) {
             act_rpm = value;
             return 0;
@@ -256,6 +569,7 @@ static float power ( float base, int pwr )
 
 static uint16_t calc_watts()
 {
+    PROFILE_SCOPE ( PROF_CALC_WATTS );
     // If no motion return 0
     if ( act_rpm == 0 ) {
         return 0;
@@ -274,6 +588,9 @@ static uint16_t calc_watts()
     // Calculate watts from torque
     pwr *= act_rpm;
 
+    // Calibration
+    pwr = pwr * wattsScale_pct / 100 + wattsOffset;
+
     // If motion don't return less than one
     if ( pwr < 1.0 ) {
         return 1;
@@ -281,24 +598,66 @@ static uint16_t calc_watts()
     return pwr;
 }
 
-static void updateResistance()
+// Step resistance one level per update towards the ERG power target
+static void updateErg()
+{
+    const uint16_t tgt = ergWatts;
+    if ( tgt == TGT_PWR_INVALID || act_rpm == 0 ) {
+        return;
+    }
+
+    const uint32_t watts = calc_watts();
+    if ( 100 * watts < ( 100 - ERG_BAND_PCT ) * ( uint32_t )tgt ) {
+        stepResistance ( INCREASE );
+    } else if ( 100 * watts > ( 100 + ERG_BAND_PCT ) * ( uint32_t )tgt ) {
+        stepResistance ( DECREASE );
+    }
+}
+
+static bool updateResistance()
 {
     const uint16_t new_res = calc_res();
     if ( SET_RES.value != new_res ) {
         SET_RES.value = new_res;
         LOG_INF ( "Changing resistance magnitude to: %d", new_res );
         sendWithRetries ( SET_RES, 3, 50 );
+        return true;
     }
+    return false;
 }
 
 void updateBike()
 {
+    bool wrote = false;
+    applyBikeTgts();
     sendWithRetries ( RPM_REQ, 0, 0 );
     if ( firstRead && ( act_inc != SET_INC.value ) ) {
         sendWithRetries ( SET_INC, 1, 50 );
         sendWithRetries ( INC_REQ, 0, 50 );
+        wrote = true;
+    }
+    updateErg();
+    wrote |= updateResistance();
+    rider_written ( wrote );
+    watts = calc_watts();
+}
+
+// Waits out the rest of the cycle, true if rider input cut it short
+bool waitRiderInput ( uint32_t timeout_ms )
+{
+    return !k_sem_take ( &rider_sem, K_MSEC ( timeout_ms ) );
+}
+
+// Only the writes for rider targets, the next poll does the rest
+void updateRiderTgts()
+{
+    bool wrote = false;
+    if ( firstRead && ( act_inc != SET_INC.value ) ) {
+        sendWithRetries ( SET_INC, 1, 50 );
+        wrote = true;
     }
-    updateResistance();
+    wrote |= updateResistance();
+    rider_written ( wrote );
 }
 
 bike_data_t getBikeData()
@@ -307,6 +666,6 @@ bike_data_t getBikeData()
     data.act_rpm = act_rpm;
     data.disp_res = disp_res;
     data.tgt_inc = SET_INC.value;
-    data.watts = calc_watts();
+    data.watts = watts;
     return data;
 }
\ No newline at end of file
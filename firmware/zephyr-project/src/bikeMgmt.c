@@ -0,0 +1,327 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bikeMgmt.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zcbor_common.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/mgmt/mcumgr/smp/smp.h>
+#include <zephyr/settings/settings.h>
+
+#include "bikeControl.h"
+#include "display.h"
+#include "logRing.h"
+#include "lvPool.h"
+#include "numFmt.h"
+#include "pages.h"
+#include "profile.h"
+
+LOG_MODULE_REGISTER ( bike_mgmt );
+
+// Control loop timing, written by main and read by SMP
+static uint32_t loopLast_ms = 0;
+static uint32_t loopMax_ms = 0;
+static uint32_t loopCount = 0;
+static uint32_t loopOverruns = 0;
+
+void bikeMgmtLoopTime ( uint32_t exec_ms )
+{
+    loopLast_ms = exec_ms;
+    loopMax_ms = MAX ( loopMax_ms, exec_ms );
+    loopCount++;
+    if ( exec_ms >= getBikeParams().poll_ms ) {
+        loopOverruns++;
+    }
+}
+
+static bool put_uint ( zcbor_state_t *zse, const char *key, uint32_t value )
+{
+    return zcbor_tstr_put_term ( zse, key )
+           && zcbor_uint32_put ( zse, value );
+}
+
+static bool put_int ( zcbor_state_t *zse, const char *key, int32_t value )
+{
+    return zcbor_tstr_put_term ( zse, key ) && zcbor_int32_put ( zse, value );
+}
+
+static int bike_mgmt_state ( struct smp_streamer *ctxt )
+{
+    zcbor_state_t *zse = ctxt->writer->zs;
+    const bike_diag_t diag = getBikeDiag();
+    const display_stats_t disp = getDisplayStats();
+    const page_stats_t page = getPageStats();
+
+    bool ok = put_uint ( zse, "rpm", diag.act_rpm )
+              && put_uint ( zse, "inc_raw", diag.act_inc )
+              && put_uint ( zse, "inc_set", diag.set_inc )
+              && put_uint ( zse, "res_raw", diag.set_res )
+              && put_uint ( zse, "res_disp", diag.disp_res )
+              && put_uint ( zse, "watts", diag.watts )
+              && put_uint ( zse, "erg_watts", diag.ergWatts )
+              && put_int ( zse, "inc_tgt", diag.held [TGT_INCLINE] )
+              && put_int ( zse, "res_tgt", diag.held [TGT_RESISTANCE] )
+              && put_uint ( zse, "inc_rx", diag.stats [TGT_INCLINE].received )
+              && put_uint ( zse, "inc_tx", diag.stats [TGT_INCLINE].issued )
+              && put_uint (
+                  zse, "res_rx", diag.stats [TGT_RESISTANCE].received )
+              && put_uint ( zse, "res_tx", diag.stats [TGT_RESISTANCE].issued )
+              && put_uint ( zse, "loop_ms", loopLast_ms )
+              && put_uint ( zse, "loop_max_ms", loopMax_ms )
+              && put_uint ( zse, "loops", loopCount )
+              && put_uint ( zse, "overruns", loopOverruns )
+              && put_uint ( zse, "disp_px_s", disp.px_per_s )
+              && put_uint ( zse, "disp_spi_bps", disp.spi_bytes_per_s )
+              && put_uint ( zse, "page", page.active )
+              && put_uint ( zse, "heap_used", page.heap_used )
+              && put_uint ( zse, "heap_peak", page.heap_peak )
+              && put_uint ( zse, "uptime_ms", k_uptime_get_32() );
+
+    return ok ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+
+static bool put_params ( zcbor_state_t *zse, const bike_params_t *params )
+{
+    return put_uint ( zse, "poll_ms", params->poll_ms )
+           && put_int ( zse, "watts_offset", params->wattsOffset )
+           && put_uint ( zse, "watts_scale", params->wattsScale_pct )
+           && put_uint ( zse, "inc_deadband", params->deadband [TGT_INCLINE] )
+           && put_uint (
+               zse, "inc_interval_ms", params->minInterval_ms [TGT_INCLINE] )
+           && put_uint (
+               zse, "res_deadband", params->deadband [TGT_RESISTANCE] )
+           && put_uint ( zse,
+                         "res_interval_ms",
+                         params->minInterval_ms [TGT_RESISTANCE] );
+}
+
+static bool key_is ( const struct zcbor_string *key, const char *name )
+{
+    return key->len == strlen ( name )
+           && !memcmp ( key->value, name, key->len );
+}
+
+static int bike_mgmt_params_read ( struct smp_streamer *ctxt )
+{
+    const bike_params_t params = getBikeParams();
+    return put_params ( ctxt->writer->zs, &params ) ? MGMT_ERR_EOK
+                                                    : MGMT_ERR_EMSGSIZE;
+}
+
+// Unlisted keys keep their value, "save": true persists the result
+static int bike_mgmt_params_write ( struct smp_streamer *ctxt )
+{
+    zcbor_state_t *zsd = ctxt->reader->zs;
+    bike_params_t params = getBikeParams();
+    struct zcbor_string key;
+    bool save = false;
+    int32_t value;
+
+    if ( !zcbor_map_start_decode ( zsd ) ) {
+        return MGMT_ERR_EINVAL;
+    }
+    while ( zcbor_tstr_decode ( zsd, &key ) ) {
+        if ( key_is ( &key, "save" ) ) {
+            if ( !zcbor_bool_decode ( zsd, &save ) ) {
+                return MGMT_ERR_EINVAL;
+            }
+            continue;
+        }
+        if ( !zcbor_int32_decode ( zsd, &value ) || value < INT16_MIN
+             || value > UINT16_MAX ) {
+            return MGMT_ERR_EINVAL;
+        }
+        // The offset is signed, check it before it's narrowed to int16_t
+        if ( key_is ( &key, "watts_offset" ) ) {
+            if ( value < -WATTS_OFFSET_MAX || value > WATTS_OFFSET_MAX ) {
+                return MGMT_ERR_EINVAL;
+            }
+        } else if ( value < 0 ) {
+            return MGMT_ERR_EINVAL;
+        }
+        if ( key_is ( &key, "poll_ms" ) ) {
+            params.poll_ms = value;
+        } else if ( key_is ( &key, "watts_offset" ) ) {
+            params.wattsOffset = value;
+        } else if ( key_is ( &key, "watts_scale" ) ) {
+            params.wattsScale_pct = value;
+        } else if ( key_is ( &key, "inc_deadband" ) ) {
+            params.deadband [TGT_INCLINE] = value;
+        } else if ( key_is ( &key, "inc_interval_ms" ) ) {
+            params.minInterval_ms [TGT_INCLINE] = value;
+        } else if ( key_is ( &key, "res_deadband" ) ) {
+            params.deadband [TGT_RESISTANCE] = value;
+        } else if ( key_is ( &key, "res_interval_ms" ) ) {
+            params.minInterval_ms [TGT_RESISTANCE] = value;
+        } else {
+            return MGMT_ERR_EINVAL;
+        }
+    }
+    zcbor_map_end_decode ( zsd );
+
+    if ( setBikeParams ( &params ) ) {
+        return MGMT_ERR_EINVAL;
+    }
+    if ( save ) {
+        int rc = settings_save_one (
+            BIKE_MGMT_SETTINGS_KEY, &params, sizeof ( params ) );
+        if ( rc ) {
+            LOG_ERR ( "Failed to save parameters: %d", rc );
+            return MGMT_ERR_EUNKNOWN;
+        }
+    }
+
+    return put_params ( ctxt->writer->zs, &params ) ? MGMT_ERR_EOK
+                                                    : MGMT_ERR_EMSGSIZE;
+}
+
+#if defined( CONFIG_LOG )
+static int bike_mgmt_log ( struct smp_streamer *ctxt )
+{
+    static uint8_t chunk [BIKE_MGMT_LOG_CHUNK];
+    zcbor_state_t *zse = ctxt->writer->zs;
+    uint32_t dropped;
+    const size_t len = logRingRead ( chunk, sizeof ( chunk ), &dropped );
+
+    bool ok = zcbor_tstr_put_lit ( zse, "data" )
+              && zcbor_bstr_encode_ptr ( zse, chunk, len )
+              && put_uint ( zse, "dropped", dropped );
+    return ok ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+#endif
+
+#if defined( CONFIG_UBIKE_PROFILE )
+// Section timing in cycles, "hz" converts to time
+static int bike_mgmt_profile ( struct smp_streamer *ctxt )
+{
+    zcbor_state_t *zse = ctxt->writer->zs;
+    profile_stats_t stats;
+
+    bool ok = put_uint ( zse, "hz", profileCyclesPerSec() );
+    for ( int i = 0; ok && i < PROF_SECTION_CNT; i++ ) {
+        profileGet ( i, &stats );
+        const uint32_t avg = stats.count ? stats.total / stats.count : 0;
+        ok = zcbor_tstr_put_term ( zse, profileName ( i ) )
+             && zcbor_map_start_encode ( zse, 7 )
+             && put_uint ( zse, "count", stats.count )
+             && put_uint ( zse, "min", stats.min )
+             && put_uint ( zse, "avg", avg )
+             && put_uint ( zse, "max", stats.max )
+             && put_uint ( zse, "p50", profilePercentile ( &stats, 50 ) )
+             && put_uint ( zse, "p90", profilePercentile ( &stats, 90 ) )
+             && put_uint ( zse, "p99", profilePercentile ( &stats, 99 ) )
+             && zcbor_map_end_encode ( zse, 7 );
+    }
+    return ok ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+
+static int bike_mgmt_profile_reset ( struct smp_streamer *ctxt )
+{
+    profileReset();
+    return MGMT_ERR_EOK;
+}
+#endif
+
+#if defined( CONFIG_UBIKE_LV_POOL )
+// Per block size class, then LVGL's heap for anything larger
+static int bike_mgmt_lv_pool ( struct smp_streamer *ctxt )
+{
+    zcbor_state_t *zse = ctxt->writer->zs;
+    const lv_pool_stats_t stats = getLvPoolStats();
+    char name [NUM_FMT_MAX_DIGITS + 1];
+
+    bool ok = put_uint ( zse, "used", stats.used )
+              && put_uint ( zse, "peak", stats.peak )
+              && put_uint ( zse, "heap_used", stats.heapUsed )
+              && put_uint ( zse, "heap_peak", stats.heapPeak )
+              && put_uint ( zse, "fails", stats.fails );
+    for ( int i = 0; ok && i < LV_POOL_CLASS_CNT; i++ ) {
+        const lv_pool_class_t *cls = &stats.classes [i];
+        NUM_FMT_UINT ( name, cls->size );
+        ok = zcbor_tstr_put_term ( zse, name )
+             && zcbor_map_start_encode ( zse, 4 )
+             && put_uint ( zse, "blocks", cls->blocks )
+             && put_uint ( zse, "used", cls->used )
+             && put_uint ( zse, "peak", cls->peak )
+             && put_uint ( zse, "spills", cls->spills )
+             && zcbor_map_end_encode ( zse, 4 );
+    }
+    return ok ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+#endif
+
+static const struct mgmt_handler bike_mgmt_handlers []
+    = { [BIKE_MGMT_ID_STATE] = { .mh_read = bike_mgmt_state,
+                                 .mh_write = NULL },
+        [BIKE_MGMT_ID_PARAMS] = { .mh_read = bike_mgmt_params_read,
+                                  .mh_write = bike_mgmt_params_write },
+#if defined( CONFIG_LOG )
+        [BIKE_MGMT_ID_LOG] = { .mh_read = bike_mgmt_log, .mh_write = NULL },
+#endif
+#if defined( CONFIG_UBIKE_PROFILE )
+        [BIKE_MGMT_ID_PROFILE] = { .mh_read = bike_mgmt_profile,
+                                   .mh_write = bike_mgmt_profile_reset },
+#endif
+#if defined( CONFIG_UBIKE_LV_POOL )
+        [BIKE_MGMT_ID_LV_POOL] = { .mh_read = bike_mgmt_lv_pool,
+                                   .mh_write = NULL },
+#endif
+};
+
+static struct mgmt_group bike_mgmt_group
+    = { .mg_handlers = bike_mgmt_handlers,
+        .mg_handlers_count = ARRAY_SIZE ( bike_mgmt_handlers ),
+        .mg_group_id = BIKE_MGMT_GROUP_ID };
+
+static int bike_settings_set ( const char *name,
+                               size_t len,
+                               settings_read_cb read_cb,
+                               void *cb_arg )
+{
+    if ( strcmp ( name, "params" ) ) {
+        return -ENOENT;
+    }
+    bike_params_t params;
+    if ( len != sizeof ( params ) ) {
+        return -EINVAL;
+    }
+
+    int rc = read_cb ( cb_arg, &params, sizeof ( params ) );
+    if ( rc < 0 ) {
+        return rc;
+    }
+    return setBikeParams ( &params );
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE (
+    bike, "bike", NULL, bike_settings_set, NULL, NULL );
+
+static int bike_mgmt_init ( const struct device *dev )
+{
+    ARG_UNUSED ( dev );
+    mgmt_register_group ( &bike_mgmt_group );
+    return 0;
+}
+
+SYS_INIT ( bike_mgmt_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
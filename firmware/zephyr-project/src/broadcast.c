@@ -0,0 +1,105 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "broadcast.h"
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "telemetry.h"
+
+LOG_MODULE_REGISTER ( broadcast );
+
+static struct bt_le_ext_adv *adv_set;
+static broadcast_data_t mfgData;
+static const struct bt_data ad []
+    = { BT_DATA_BYTES ( BT_DATA_FLAGS, BT_LE_AD_NO_BREDR ),
+        BT_DATA ( BT_DATA_MANUFACTURER_DATA, &mfgData, sizeof ( mfgData ) ) };
+
+static void broadcast_work_handler ( struct k_work *work );
+K_WORK_DELAYABLE_DEFINE ( broadcast_work, broadcast_work_handler );
+
+static uint16_t get_bike_id()
+{
+    if ( CONFIG_UBIKE_BROADCAST_BIKE_ID ) {
+        return CONFIG_UBIKE_BROADCAST_BIKE_ID;
+    }
+
+    bt_addr_le_t addr;
+    size_t count = 1;
+    bt_id_get ( &addr, &count );
+    return sys_get_le16 ( addr.a.val );
+}
+
+static void broadcast_work_handler ( struct k_work *work )
+{
+    bike_data_t bikeData;
+    telemetryGetSample ( &bikeData );
+
+    mfgData.seq++;
+    mfgData.watts = sys_cpu_to_le16 ( bikeData.watts );
+    mfgData.rpm = MIN ( bikeData.act_rpm, UINT8_MAX );
+    mfgData.resistance = bikeData.disp_res;
+    mfgData.incline
+        = sys_cpu_to_le16 ( 5 * ( ( int16_t )bikeData.tgt_inc - 20 ) );
+
+    int err = bt_le_ext_adv_set_data (
+        adv_set, ad, ARRAY_SIZE ( ad ), NULL, 0 );
+    if ( err ) {
+        LOG_WRN ( "Failed to update broadcast data: %d", err );
+    }
+
+    k_work_schedule ( &broadcast_work,
+                      K_MSEC ( CONFIG_UBIKE_BROADCAST_UPDATE_MS ) );
+}
+
+int broadcastStart()
+{
+    // Non-connectable legacy PDUs so any scanner can receive them
+    const struct bt_le_adv_param param
+        = BT_LE_ADV_PARAM_INIT ( BT_LE_ADV_OPT_USE_IDENTITY,
+                                 BT_GAP_ADV_FAST_INT_MIN_2,
+                                 BT_GAP_ADV_FAST_INT_MAX_2,
+                                 NULL );
+
+    mfgData.companyId = sys_cpu_to_le16 ( BROADCAST_COMPANY_ID );
+    mfgData.bikeId = sys_cpu_to_le16 ( get_bike_id() );
+
+    int err = bt_le_ext_adv_create ( &param, NULL, &adv_set );
+    if ( err ) {
+        LOG_ERR ( "Failed to create broadcast set: %d", err );
+        return err;
+    }
+    err = bt_le_ext_adv_set_data ( adv_set, ad, ARRAY_SIZE ( ad ), NULL, 0 );
+    if ( err ) {
+        LOG_ERR ( "Failed to set broadcast data: %d", err );
+        return err;
+    }
+    err = bt_le_ext_adv_start ( adv_set, BT_LE_EXT_ADV_START_DEFAULT );
+    if ( err ) {
+        LOG_ERR ( "Failed to start broadcast: %d", err );
+        return err;
+    }
+
+    LOG_INF ( "Broadcasting as bike %u", sys_le16_to_cpu ( mfgData.bikeId ) );
+    k_work_schedule ( &broadcast_work,
+                      K_MSEC ( CONFIG_UBIKE_BROADCAST_UPDATE_MS ) );
+    return 0;
+}
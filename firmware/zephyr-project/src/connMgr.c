@@ -0,0 +1,241 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "connMgr.h"
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#if defined( CONFIG_MCUMGR_MGMT_NOTIFICATION_HOOKS )
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#endif
+
+LOG_MODULE_REGISTER ( conn );
+
+typedef struct
+{
+    struct bt_conn *conn;
+    struct k_work setupWork;
+    struct k_work fastWork;
+    struct k_work_delayable idleWork;
+    bool fast;
+} conn_state_t;
+
+static struct k_spinlock connLock;
+static conn_state_t connStates [CONFIG_BT_MAX_CONN];
+
+static const struct bt_le_conn_param fastParams
+    = BT_LE_CONN_PARAM_INIT ( CONN_FAST_MIN_INT,
+                              CONN_FAST_MAX_INT,
+                              CONN_FAST_LATENCY,
+                              CONN_FAST_TIMEOUT );
+static const struct bt_le_conn_param idleParams
+    = BT_LE_CONN_PARAM_INIT ( CONN_IDLE_MIN_INT,
+                              CONN_IDLE_MAX_INT,
+                              CONN_IDLE_LATENCY,
+                              CONN_IDLE_TIMEOUT );
+
+static conn_state_t *getState ( struct bt_conn *conn )
+{
+    conn_state_t *state = &connStates [bt_conn_index ( conn )];
+    return state->conn == conn ? state : NULL;
+}
+
+// Handlers run on the work queue and may race a disconnect, they take
+// their own reference so the connection outlives the request
+static struct bt_conn *hold_conn ( conn_state_t *state )
+{
+    k_spinlock_key_t key = k_spin_lock ( &connLock );
+    struct bt_conn *conn = state->conn ? bt_conn_ref ( state->conn ) : NULL;
+    k_spin_unlock ( &connLock, key );
+    return conn;
+}
+
+static void setupHandler ( struct k_work *work )
+{
+    conn_state_t *state = CONTAINER_OF ( work, conn_state_t, setupWork );
+    struct bt_conn *conn = hold_conn ( state );
+    if ( !conn ) {
+        return;
+    }
+
+    // 2M PHY and max data length speed up SMP transfers
+    int err = bt_conn_le_phy_update ( conn, BT_CONN_LE_PHY_PARAM_2M );
+    if ( err ) {
+        LOG_WRN ( "PHY update request failed: %d", err );
+    }
+    err = bt_conn_le_data_len_update ( conn, BT_LE_DATA_LEN_PARAM_MAX );
+    if ( err ) {
+        LOG_WRN ( "Data length update request failed: %d", err );
+    }
+    bt_conn_unref ( conn );
+}
+
+static void fastHandler ( struct k_work *work )
+{
+    conn_state_t *state = CONTAINER_OF ( work, conn_state_t, fastWork );
+    if ( state->fast ) {
+        return;
+    }
+    struct bt_conn *conn = hold_conn ( state );
+    if ( !conn ) {
+        return;
+    }
+
+    int err = bt_conn_le_param_update ( conn, &fastParams );
+    if ( err ) {
+        LOG_WRN ( "Fast connection parameter request failed: %d", err );
+    } else {
+        state->fast = true;
+    }
+    bt_conn_unref ( conn );
+}
+
+static void idleHandler ( struct k_work *work )
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work ( work );
+    conn_state_t *state = CONTAINER_OF ( dwork, conn_state_t, idleWork );
+    struct bt_conn *conn = hold_conn ( state );
+    if ( !conn ) {
+        return;
+    }
+
+    int err = bt_conn_le_param_update ( conn, &idleParams );
+    if ( err ) {
+        LOG_WRN ( "Idle connection parameter request failed: %d", err );
+    } else {
+        state->fast = false;
+    }
+    bt_conn_unref ( conn );
+}
+
+void connMgrConnected ( struct bt_conn *conn )
+{
+    conn_state_t *state = &connStates [bt_conn_index ( conn )];
+    k_spinlock_key_t key = k_spin_lock ( &connLock );
+    state->conn = bt_conn_ref ( conn );
+    state->fast = false;
+    k_spin_unlock ( &connLock, key );
+
+    // HCI requests are made from the work queue, not the BT RX thread
+    k_work_submit ( &state->setupWork );
+    k_work_schedule ( &state->idleWork, K_MSEC ( CONN_IDLE_AFTER_MS ) );
+}
+
+void connMgrDisconnected ( struct bt_conn *conn )
+{
+    conn_state_t *state = getState ( conn );
+    if ( !state ) {
+        return;
+    }
+
+    // Called from the BT RX thread, so no waiting on the work queue.
+    // Anything already running holds its own reference.
+    k_spinlock_key_t key = k_spin_lock ( &connLock );
+    state->conn = NULL;
+    k_spin_unlock ( &connLock, key );
+    k_work_cancel ( &state->setupWork );
+    k_work_cancel ( &state->fastWork );
+    k_work_cancel_delayable ( &state->idleWork );
+    bt_conn_unref ( conn );
+}
+
+void connMgrControlActivity ( struct bt_conn *conn )
+{
+    conn_state_t *state = getState ( conn );
+    if ( !state ) {
+        return;
+    }
+
+    if ( !state->fast ) {
+        k_work_submit ( &state->fastWork );
+    }
+    k_work_reschedule ( &state->idleWork, K_MSEC ( CONN_IDLE_AFTER_MS ) );
+}
+
+#if defined( CONFIG_MCUMGR_MGMT_NOTIFICATION_HOOKS )
+static void bulk_activity ( struct bt_conn *conn, void *user_data )
+{
+    ARG_UNUSED ( user_data );
+    connMgrControlActivity ( conn );
+}
+
+// Image uploads keep the link on the fast interval until they finish
+static int32_t dfu_chunk ( uint32_t event,
+                           int32_t rc,
+                           bool *abort_more,
+                           void *data,
+                           size_t data_size )
+{
+    bt_conn_foreach ( BT_CONN_TYPE_LE, bulk_activity, NULL );
+    return MGMT_ERR_EOK;
+}
+
+static struct mgmt_callback dfu_callback
+    = { .callback = dfu_chunk, .event_id = MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK };
+#endif
+
+// Work items are set up once, a new connection can reuse a slot while
+// the last one's handler is still finishing
+static int conn_mgr_init ( const struct device *dev )
+{
+    ARG_UNUSED ( dev );
+    for ( int i = 0; i < ARRAY_SIZE ( connStates ); i++ ) {
+        k_work_init ( &connStates [i].setupWork, setupHandler );
+        k_work_init ( &connStates [i].fastWork, fastHandler );
+        k_work_init_delayable ( &connStates [i].idleWork, idleHandler );
+    }
+#if defined( CONFIG_MCUMGR_MGMT_NOTIFICATION_HOOKS )
+    mgmt_callback_register ( &dfu_callback );
+#endif
+    return 0;
+}
+
+SYS_INIT ( conn_mgr_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
+
+static void le_param_updated ( struct bt_conn *conn,
+                               uint16_t interval,
+                               uint16_t latency,
+                               uint16_t timeout )
+{
+    LOG_INF ( "Connection parameters: interval %u, latency %u, timeout %u",
+              interval,
+              latency,
+              timeout );
+}
+
+static void le_phy_updated ( struct bt_conn *conn,
+                             struct bt_conn_le_phy_info *param )
+{
+    LOG_INF ( "PHY updated: tx %u, rx %u", param->tx_phy, param->rx_phy );
+}
+
+static void le_data_len_updated ( struct bt_conn *conn,
+                                  struct bt_conn_le_data_len_info *info )
+{
+    LOG_INF ( "Data length updated: tx %u, rx %u",
+              info->tx_max_len,
+              info->rx_max_len );
+}
+
+BT_CONN_CB_DEFINE ( conn_mgr_callbacks )
+    = { .le_param_updated = le_param_updated,
+        .le_phy_updated = le_phy_updated,
+        .le_data_len_updated = le_data_len_updated };
@@ -0,0 +1,178 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <lvgl.h>
+#include <zephyr/kernel.h>
+
+#include "bikeControl.h"
+#include "numFmt.h"
+#include "pages.h"
+
+#define CONTROL_BTN_SIZE 64
+#define CONTROL_SLIDER_W 150
+#define CONTROL_SLIDER_H 16
+#define CONTROL_INC_Y 60
+#define CONTROL_RES_Y 240
+#define CONTROL_INC_MAX 60  // Counts of 0.5% from -10%
+#define CONTROL_RES_MIN 1
+#define CONTROL_RES_MAX 22
+
+typedef struct
+{
+    lv_obj_t *value;
+    lv_obj_t *slider;
+    char text [8];
+} control_row_t;
+
+static control_row_t incRow;
+static control_row_t resRow;
+static lv_style_t controlStyle;
+
+// Same path as the handlebar buttons, on press rather than release
+static void inc_step_cb ( lv_event_t *e )
+{
+    adjustIncline (
+        ( buttonStatus_t )( intptr_t )lv_event_get_user_data ( e ) );
+}
+
+static void res_step_cb ( lv_event_t *e )
+{
+    adjustResistance (
+        ( buttonStatus_t )( intptr_t )lv_event_get_user_data ( e ) );
+}
+
+// Dragging only moves the slider, the target is sent on release
+static void inc_slider_cb ( lv_event_t *e )
+{
+    setRiderIncline ( lv_slider_get_value ( lv_event_get_target ( e ) ) );
+}
+
+static void res_slider_cb ( lv_event_t *e )
+{
+    setRiderResistance ( lv_slider_get_value ( lv_event_get_target ( e ) ) );
+}
+
+static void add_step ( lv_obj_t *scr,
+                       lv_coord_t x,
+                       lv_coord_t y,
+                       lv_event_cb_t cb,
+                       buttonStatus_t adj )
+{
+    lv_obj_t *btn = lv_btn_create ( scr );
+    lv_obj_set_size ( btn, CONTROL_BTN_SIZE, CONTROL_BTN_SIZE );
+    lv_obj_align ( btn, LV_ALIGN_TOP_LEFT, x, y );
+    void *user = ( void * )( intptr_t )adj;
+    lv_obj_add_event_cb ( btn, cb, LV_EVENT_PRESSED, user );
+    lv_obj_add_event_cb ( btn, cb, LV_EVENT_LONG_PRESSED_REPEAT, user );
+
+    lv_obj_t *label = lv_label_create ( btn );
+    lv_obj_add_style ( label, &controlStyle, 0 );
+    lv_label_set_text_static ( label, adj == INCREASE ? "+" : "-" );
+    lv_obj_center ( label );
+}
+
+static void create_row ( lv_obj_t *scr,
+                         control_row_t *row,
+                         const char *name,
+                         lv_coord_t y,
+                         int32_t min,
+                         int32_t max,
+                         lv_event_cb_t stepCb,
+                         lv_event_cb_t sliderCb )
+{
+    lv_obj_t *nameLabel = lv_label_create ( scr );
+    lv_obj_add_style ( nameLabel, &controlStyle, 0 );
+    lv_label_set_text_static ( nameLabel, name );
+    lv_obj_align ( nameLabel, LV_ALIGN_TOP_LEFT, 12, y );
+
+    row->value = lv_label_create ( scr );
+    lv_obj_add_style ( row->value, &controlStyle, 0 );
+    lv_obj_align ( row->value, LV_ALIGN_TOP_RIGHT, -12, y );
+    row->text [0] = '\0';
+    lv_label_set_text_static ( row->value, row->text );
+
+    const lv_coord_t ctrlY = y + 48;
+    add_step ( scr, 8, ctrlY, stepCb, DECREASE );
+    add_step ( scr, 320 - 8 - CONTROL_BTN_SIZE, ctrlY, stepCb, INCREASE );
+
+    row->slider = lv_slider_create ( scr );
+    lv_slider_set_range ( row->slider, min, max );
+    lv_obj_set_size ( row->slider, CONTROL_SLIDER_W, CONTROL_SLIDER_H );
+    lv_obj_align ( row->slider,
+                   LV_ALIGN_TOP_MID,
+                   0,
+                   ctrlY + ( CONTROL_BTN_SIZE - CONTROL_SLIDER_H ) / 2 );
+    lv_obj_add_event_cb ( row->slider, sliderCb, LV_EVENT_RELEASED, NULL );
+    // Slider drags aren't page swipes
+    lv_obj_clear_flag ( row->slider, LV_OBJ_FLAG_GESTURE_BUBBLE );
+}
+
+static void update_row ( control_row_t *row, int32_t value, const char *text )
+{
+    if ( !lv_obj_has_state ( row->slider, LV_STATE_PRESSED ) ) {
+        lv_slider_set_value ( row->slider, value, LV_ANIM_OFF );
+    }
+    if ( strcmp ( row->text, text ) ) {
+        strcpy ( row->text, text );
+        lv_label_set_text_static ( row->value, row->text );
+    }
+}
+
+static void control_create ( lv_obj_t *scr )
+{
+    static bool styled = false;
+    if ( !styled ) {
+        lv_style_init ( &controlStyle );
+        lv_style_set_text_font ( &controlStyle, &lv_font_montserrat_24 );
+        styled = true;
+    }
+
+    create_row ( scr,
+                 &incRow,
+                 "Incline",
+                 CONTROL_INC_Y,
+                 0,
+                 CONTROL_INC_MAX,
+                 inc_step_cb,
+                 inc_slider_cb );
+    create_row ( scr,
+                 &resRow,
+                 "Resistance",
+                 CONTROL_RES_Y,
+                 CONTROL_RES_MIN,
+                 CONTROL_RES_MAX,
+                 res_step_cb,
+                 res_slider_cb );
+}
+
+static void control_update ( const bike_data_t *data )
+{
+    char text [sizeof ( incRow.text )];
+
+    numFmtIncline ( text, sizeof ( text ), data->tgt_inc );
+    update_row ( &incRow, data->tgt_inc, text );
+
+    NUM_FMT_UINT ( text, data->disp_res );
+    update_row ( &resRow, data->disp_res, text );
+}
+
+const page_desc_t controlPage = { .title = "Controls",
+                                  .create = control_create,
+                                  .update = control_update,
+                                  .resident = false };
@@ -30,8 +30,9 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/types.h>
 
+#include "telemetry.h"
+
 LOG_MODULE_REGISTER ( cps );
-static bool notify_enabled = false;
 
 // Read feature callback
 static ble_cps_features_t cps_features = {};
@@ -55,9 +56,8 @@ static void cps_ccc_cfg_changed ( const struct bt_gatt_attr *attr,
 {
     ARG_UNUSED ( attr );
 
-    notify_enabled = ( value == BT_GATT_CCC_NOTIFY );
-
-    LOG_INF ( "CPS notifications %s", notify_enabled ? "enabled" : "disabled" );
+    LOG_INF ( "CPS notifications %s",
+              value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled" );
 }
 
 BT_GATT_SERVICE_DEFINE (
@@ -78,30 +78,26 @@ BT_GATT_SERVICE_DEFINE (
     BT_GATT_CCC ( cps_ccc_cfg_changed,
                   ( BT_GATT_PERM_READ | BT_GATT_PERM_WRITE ) ) );
 
-static int cps_init ( const struct device *dev )
+static size_t encode_measurement ( const bike_data_t *bikeData, void *buf )
 {
-    ARG_UNUSED ( dev );
-
-    /// cps_features doesn't use any optional flags
-
-    return 0;
+    ble_cps_measurement_data_t *data = buf;
+    data->flags = 0;
+    data->InstantaneousPower = bikeData->watts;
+    return sizeof ( ble_cps_measurement_data_t );
 }
 
-int bt_cps_notify ( bike_data_t bikeData )
+TELEMETRY_FRAME_DEFINE ( cps_frame,
+                         cps_svc,
+                         BLE_UUID_CYCLING_POWER_MEASUREMENT_CHAR,
+                         encode_measurement );
+
+static int cps_init ( const struct device *dev )
 {
-    if ( !notify_enabled ) {
-        return -EACCES;
-    }
+    ARG_UNUSED ( dev );
 
-    static ble_cps_measurement_data_t data = {};
-    data.InstantaneousPower = bikeData.watts;
+    /// cps_features doesn't use any optional flags
 
-    int rc = bt_gatt_notify_uuid ( NULL,
-                                   BLE_UUID_CYCLING_POWER_MEASUREMENT_CHAR,
-                                   cps_svc.attrs,
-                                   &data,
-                                   sizeof ( data ) );
-    return rc == -ENOTCONN ? 0 : rc;
+    return telemetryRegister ( &cps_frame );
 }
 
 SYS_INIT ( cps_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
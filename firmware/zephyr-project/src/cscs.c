@@ -30,8 +30,9 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/types.h>
 
+#include "telemetry.h"
+
 LOG_MODULE_REGISTER ( cscs );
-static bool notify_enabled = false;
 
 // Read feature callback
 static ble_cscs_features_t cscs_features = {};
@@ -55,10 +56,8 @@ static void cscs_ccc_cfg_changed ( const struct bt_gatt_attr *attr,
 {
     ARG_UNUSED ( attr );
 
-    notify_enabled = ( value == BT_GATT_CCC_NOTIFY );
-
     LOG_INF ( "CSCS notifications %s",
-              notify_enabled ? "enabled" : "disabled" );
+              value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled" );
 }
 
 BT_GATT_SERVICE_DEFINE (
@@ -79,15 +78,6 @@ BT_GATT_SERVICE_DEFINE (
     BT_GATT_CCC ( cscs_ccc_cfg_changed,
                   ( BT_GATT_PERM_READ | BT_GATT_PERM_WRITE ) ) );
 
-static int cscs_init ( const struct device *dev )
-{
-    ARG_UNUSED ( dev );
-
-    cscs_features.feat_blsc = BLE_CSCS_FEATURE_CRANK_REV;
-
-    return 0;
-}
-
 static void set_crank_data ( uint16_t rpm, ble_cscs_measurement_data_t *data )
 {
     data->flags = BLE_CSCS_CRANK_FLAGS_FIELD;
@@ -112,21 +102,26 @@ static void set_crank_data ( uint16_t rpm, ble_cscs_measurement_data_t *data )
     data->lastCrank_1024 = ( lastRev_ms * 128LL ) / 125LL;
 }
 
-int bt_cscs_bike_notify ( bike_data_t bikeData )
+static size_t encode_measurement ( const bike_data_t *bikeData, void *buf )
 {
-    if ( !notify_enabled ) {
-        return -EACCES;
-    }
-
     static ble_cscs_measurement_data_t data = {};
-    set_crank_data ( bikeData.act_rpm, &data );
-
-    int rc = bt_gatt_notify_uuid ( NULL,
-                                   BLE_UUID_CSCS_MEASUREMENT_CHAR,
-                                   cscs_svc.attrs,
-                                   &data,
-                                   sizeof ( data ) );
-    return rc == -ENOTCONN ? 0 : rc;
+    set_crank_data ( bikeData->act_rpm, &data );
+    memcpy ( buf, &data, sizeof ( data ) );
+    return sizeof ( data );
+}
+
+TELEMETRY_FRAME_DEFINE ( cscs_frame,
+                         cscs_svc,
+                         BLE_UUID_CSCS_MEASUREMENT_CHAR,
+                         encode_measurement );
+
+static int cscs_init ( const struct device *dev )
+{
+    ARG_UNUSED ( dev );
+
+    cscs_features.feat_blsc = BLE_CSCS_FEATURE_CRANK_REV;
+
+    return telemetryRegister ( &cscs_frame );
 }
 
 SYS_INIT ( cscs_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
\ No newline at end of file
@@ -21,21 +21,28 @@
 #include <lvgl.h>
 #include <zephyr/drivers/display.h>
 #include <zephyr/drivers/kscan.h>
-#include <zephyr/drivers/pwm.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
 #include "common.h"
+#include "displayFlush.h"
+#include "displayPower.h"
+#include "infoPages.h"
+#include "numFmt.h"
+#include "numLabel.h"
+#include "pages.h"
+#include "profile.h"
+#include "trend.h"
 #include "version.h"
 
-#define BL_PWM_NODE DT_ALIAS ( blpwm )
-#define PWM_PERIOD PWM_MSEC ( 1U )  // 1 kHz
-#define DIM_MS 10000U               // 10s
-#define ASLEEP_MS 60000U            // 60s
-#define SEM_TIMEOUT K_MSEC ( 50 )
+#define STATS_WINDOW_MS 1000U
 
-#define STACKSIZE 2048
-#define PRIORITY 15
+#define STACKSIZE 4096
+#define PRIORITY 14
+#define FRAME_TOUCH_MS 33U   // ~30 Hz while touched
+#define FRAME_IDLE_MS 100U   // Touch polling when idle
+#define FRAME_MAX_MS 1000U
+#define TOUCH_HOLD_MS 3000U  // Touch rate held after the last input
 
 #define SHA_CHAR_LEN 7
 #define MAX_VERSION_LEN 64
@@ -43,25 +50,31 @@
 
 LOG_MODULE_REGISTER ( display );
 
-K_SEM_DEFINE ( data_sem, 1, 1 );  // Default to taken
+K_SEM_DEFINE ( data_sem, 0, 1 );  // Given on new telemetry
+static struct k_spinlock dataLock;
+static uint32_t dataSeq = 0;  // Bumped for each new snapshot
+static atomic_t wakeReq = ATOMIC_INIT ( 0 );
 static const struct device *display_dev
     = DEVICE_DT_GET ( DT_CHOSEN ( zephyr_display ) );
-static const struct pwm_dt_spec blPwm = PWM_DT_SPEC_GET ( BL_PWM_NODE );
 static bike_data_t bikeData = {};
-
-static lv_obj_t *rpm_label;
-static lv_obj_t *pwr_label;
-static lv_obj_t *inc_label;
-static lv_obj_t *res_label;
+static display_model_t model = {};
+static display_stats_t dispStats = {};
+static uint64_t pxCount = 0;  // Rendered this stats window
+static uint32_t statsStart_ms = 0;
+static uint8_t bytesPerPx = 2;
+
+static num_label_t rpm_label;
+static num_label_t pwr_label;
+static num_label_t inc_label;
+static num_label_t res_label;
 static lv_obj_t *rpm_desc_label;
 static lv_obj_t *pwr_desc_label;
 static lv_obj_t *inc_desc_label;
 static lv_obj_t *res_desc_label;
 static lv_obj_t *version_label;
-static lv_obj_t *swLabel;
+static num_label_t swLabel;
 static lv_obj_t *btnLabel;
 static lv_obj_t *btn;
-static lv_style_t style;
 static lv_style_t descStyle;
 static lv_style_t shaStyle;
 static lv_style_t btnStyle;
@@ -73,31 +86,11 @@ static char resString [3];                 // 99
 static char swString [9];                  // 00:00:00
 static char versionString [MAX_VERSION_LEN];
 
-void updateBacklight ( bool wakeUp )
+// Safe from any context, the display thread applies it on its next pass
+void displayWake()
 {
-    static uint32_t lastActive_ms = 0;
-    if ( wakeUp ) {
-        lastActive_ms = k_uptime_get_32();
-    }
-
-    int64_t elapsed_ms = k_uptime_get_32() - lastActive_ms;
-    if ( elapsed_ms < 0 ) {
-        elapsed_ms += 1LL << 32;
-    }
-
-    uint8_t intensity;
-    if ( elapsed_ms < DIM_MS ) {
-        intensity = 100;
-    } else if ( elapsed_ms < ASLEEP_MS ) {
-        intensity = 10;
-    } else {
-        intensity = 5;
-    }
-
-    // Set backlight intensity
-    pwm_set_dt ( &blPwm,
-                 PWM_PERIOD,
-                 ( PWM_PERIOD * ( 100 - intensity ) ) / 100 );
+    atomic_set ( &wakeReq, 1 );
+    k_sem_give ( &data_sem );
 }
 
 static void k_callback ( const struct device *dev,
@@ -108,7 +101,7 @@ static void k_callback ( const struct device *dev,
     ARG_UNUSED ( dev );
     if ( pressed ) {
         LOG_INF ( "row = %u col = %u\n", row, col );
-        updateBacklight ( true );
+        displayWake();
 
         if ( col >= 410 ) {
             resetTime();
@@ -120,6 +113,7 @@ void resetTime()
 {
     LOG_INF ( "Resetting timer..." );
     memset ( &swData, 0, sizeof ( stopwatch_data_t ) );
+    summaryReset();
 }
 
 static void incrementStopwatch ( int64_t elapsed_ms )
@@ -144,61 +138,92 @@ static void incrementStopwatch ( int64_t elapsed_ms )
 
 static void updateSwString()
 {
-    if ( swData.hrs < 10 ) {
-        sprintf ( &swString [0], "0%u:", swData.hrs );
-    } else {
-        sprintf ( &swString [0], "%u:", swData.hrs );
-    }
-    if ( swData.mins < 10 ) {
-        sprintf ( &swString [3], "0%u:", swData.mins );
-    } else {
-        sprintf ( &swString [3], "%u:", swData.mins );
-    }
-    if ( swData.secs < 10 ) {
-        sprintf ( &swString [6], "0%u", swData.secs );
-    } else {
-        sprintf ( &swString [6], "%u", swData.secs );
-    }
+    numFmtPad ( &swString [0], 2, swData.hrs );  // Saturates at 99
+    swString [2] = ':';
+    numFmtPad ( &swString [3], 2, swData.mins );
+    swString [5] = ':';
+    numFmtPad ( &swString [6], 2, swData.secs );
+    swString [8] = '\0';
 }
 
 static void updateRpmString ( uint16_t act_rpm )
 {
-    sprintf ( &rpmString [0], "%u", act_rpm );
+    NUM_FMT_UINT ( rpmString, act_rpm );
 }
 
 static void updatePwrString ( uint16_t watts )
 {
-    sprintf ( &pwrString [0], "%u", watts );
+    NUM_FMT_UINT ( pwrString, watts );
 }
 
 static void updateIncString ( uint16_t tgt_inc )
 {
-    int16_t per = ( ( int16_t )tgt_inc - 20 ) / 2;
-    if ( tgt_inc < 20 ) {
-        sprintf ( &incString [0], "-%d.%u%c", -per, tgt_inc % 2 ? 5 : 0, '%' );
-    } else {
-        sprintf ( &incString [0], "%d.%u%c", per, tgt_inc % 2 ? 5 : 0, '%' );
-    }
+    numFmtIncline ( incString, sizeof ( incString ), tgt_inc );
 }
 
 static void updateResString ( uint16_t disp_res )
 {
-    sprintf ( &resString [0], "%u", disp_res );
+    NUM_FMT_UINT ( resString, disp_res );
 }
 
 static void updateLabels ( bike_data_t bikeData )
 {
-    updateRpmString ( bikeData.act_rpm );
-    updatePwrString ( bikeData.watts );
-    updateIncString ( bikeData.tgt_inc );
-    updateResString ( bikeData.disp_res );
-    updateSwString();
-
-    lv_label_set_text_fmt ( rpm_label, "%s", rpmString );
-    lv_label_set_text_fmt ( pwr_label, "%s", pwrString );
-    lv_label_set_text_fmt ( inc_label, "%s", incString );
-    lv_label_set_text_fmt ( res_label, "%s", resString );
-    lv_label_set_text_fmt ( swLabel, "%s", swString );
+    PROFILE_SCOPE ( PROF_UPDATE_LABELS );
+    const uint32_t swSecs
+        = ( swData.hrs * 60U + swData.mins ) * 60U + swData.secs;
+
+    // Only changed values are formatted and invalidated
+    if ( !model.valid || bikeData.act_rpm != model.act_rpm ) {
+        updateRpmString ( bikeData.act_rpm );
+        numLabelSetText ( &rpm_label, rpmString );
+    }
+    if ( !model.valid || bikeData.watts != model.watts ) {
+        updatePwrString ( bikeData.watts );
+        numLabelSetText ( &pwr_label, pwrString );
+    }
+    if ( !model.valid || bikeData.tgt_inc != model.tgt_inc ) {
+        updateIncString ( bikeData.tgt_inc );
+        numLabelSetText ( &inc_label, incString );
+    }
+    if ( !model.valid || bikeData.disp_res != model.disp_res ) {
+        updateResString ( bikeData.disp_res );
+        numLabelSetText ( &res_label, resString );
+    }
+    if ( !model.valid || swSecs != model.swSecs ) {
+        updateSwString();
+        numLabelSetText ( &swLabel, swString );
+    }
+
+    model.act_rpm = bikeData.act_rpm;
+    model.watts = bikeData.watts;
+    model.tgt_inc = bikeData.tgt_inc;
+    model.disp_res = bikeData.disp_res;
+    model.swSecs = swSecs;
+    model.valid = true;
+}
+
+// Called by LVGL after each refresh with the pixels it rendered
+static void monitorCb ( lv_disp_drv_t *drv, uint32_t time, uint32_t px )
+{
+    pxCount += px;
+}
+
+static void updateDisplayStats()
+{
+    const uint32_t now_ms = k_uptime_get_32();
+    const uint32_t elapsed_ms = now_ms - statsStart_ms;
+    if ( elapsed_ms < STATS_WINDOW_MS ) {
+        return;
+    }
+    dispStats.px_per_s = pxCount * 1000U / elapsed_ms;
+    dispStats.spi_bytes_per_s = dispStats.px_per_s * bytesPerPx;
+    pxCount = 0;
+    statsStart_ms = now_ms;
+}
+
+display_stats_t getDisplayStats()
+{
+    return dispStats;
 }
 
 static void updateStopwatch ( bool running )
@@ -211,9 +236,9 @@ static void updateStopwatch ( bool running )
     swData.last_ms = now_ms;
 }
 
-static void screenCb ( lv_event_t *e )
+static void wakeCb ( lv_event_t *e )
 {
-    updateBacklight ( true );
+    displayWake();
 }
 
 static void buttonCb ( lv_event_t *e )
@@ -222,12 +247,12 @@ static void buttonCb ( lv_event_t *e )
     resetTime();
 }
 
-static void drawButton()
+static void drawButton ( lv_obj_t *scr )
 {
-    btn = lv_btn_create ( lv_scr_act() );
+    btn = lv_btn_create ( scr );
     lv_obj_add_event_cb ( btn, buttonCb, LV_EVENT_PRESSED, NULL );
-    lv_obj_align ( btn, LV_ALIGN_TOP_MID, 0, 410 );
-    lv_obj_set_height ( btn, 60 );
+    lv_obj_align ( btn, LV_ALIGN_TOP_MID, 0, 440 );
+    lv_obj_set_height ( btn, 38 );
     lv_obj_set_width ( btn, 300 );
 
     btnLabel = lv_label_create ( btn );
@@ -238,21 +263,12 @@ static void drawButton()
     lv_obj_center ( btnLabel );
 }
 
-/*static void sliderCb ( lv_event_t *e )
+static void drawTrend ( lv_obj_t *scr )
 {
-    lv_obj_t *slider = lv_event_get_target ( e );
-    LOG_INF ( "Slider value: %d", lv_slider_get_value ( slider ) );
+    lv_obj_t *chart = trendCreate ( scr, 300, 52 );
+    lv_obj_align ( chart, LV_ALIGN_TOP_MID, 0, 384 );
 }
 
-static void drawSlider()
-{
-    lv_obj_t * slider = lv_slider_create(lv_scr_act());
-    lv_obj_align ( slider, LV_ALIGN_TOP_MID, 0, 440 );
-    lv_obj_add_event_cb(slider, sliderCb, LV_EVENT_VALUE_CHANGED, NULL);
-    lv_obj_set_height ( slider, 30 );
-    lv_obj_set_width ( slider, 300 );
-}*/
-
 void getGitVersionChar(char *buff)
 {
     // Use git tag if not empty
@@ -266,7 +282,7 @@ void getGitVersionChar(char *buff)
     }
 }
 
-static void drawLines()
+static void drawLines ( lv_obj_t *scr )
 {
     static lv_point_t linePts1 [] = { { 0, 40 }, { 319, 40 } };
     static lv_point_t linePts2 [] = { { 0, 160 }, { 319, 160 } };
@@ -277,9 +293,9 @@ static void drawLines()
     lv_style_set_line_width ( &style, 4 );
 
     lv_obj_t *line1, *line2, *line3;
-    line1 = lv_line_create ( lv_scr_act() );
-    line2 = lv_line_create ( lv_scr_act() );
-    line3 = lv_line_create ( lv_scr_act() );
+    line1 = lv_line_create ( scr );
+    line2 = lv_line_create ( scr );
+    line3 = lv_line_create ( scr );
     lv_line_set_points ( line1, linePts1, 2 );
     lv_line_set_points ( line2, linePts2, 2 );
     lv_line_set_points ( line3, linePts3, 2 );
@@ -288,13 +304,13 @@ static void drawLines()
     lv_obj_add_style ( line3, &style, 0 );
 }
 
-static void drawLabels()
+static void drawLabels ( lv_obj_t *scr )
 {
-    rpm_desc_label = lv_label_create ( lv_scr_act() );
-    pwr_desc_label = lv_label_create ( lv_scr_act() );
-    inc_desc_label = lv_label_create ( lv_scr_act() );
-    res_desc_label = lv_label_create ( lv_scr_act() );
-    version_label = lv_label_create ( lv_scr_act() );
+    rpm_desc_label = lv_label_create ( scr );
+    pwr_desc_label = lv_label_create ( scr );
+    inc_desc_label = lv_label_create ( scr );
+    res_desc_label = lv_label_create ( scr );
+    version_label = lv_label_create ( scr );
 
     lv_style_init ( &descStyle );
     lv_style_set_text_font ( &descStyle, &lv_font_montserrat_24 );
@@ -319,26 +335,103 @@ static void drawLabels()
     getGitVersionChar ( versionString );
     lv_label_set_text ( version_label, versionString );
 
-    rpm_label = lv_label_create ( lv_scr_act() );
-    pwr_label = lv_label_create ( lv_scr_act() );
-    inc_label = lv_label_create ( lv_scr_act() );
-    res_label = lv_label_create ( lv_scr_act() );
-    swLabel = lv_label_create ( lv_scr_act() );
+    // Metrics use fixed digit cells of the digit subset font
+    numLabelCreate ( &rpm_label, scr, &ubike_digits_48, 3 );
+    numLabelCreate ( &pwr_label, scr, &ubike_digits_48, 4 );
+    numLabelCreate ( &inc_label, scr, &ubike_digits_48, 6 );
+    numLabelCreate ( &res_label, scr, &ubike_digits_48, 2 );
+    numLabelCreate ( &swLabel, scr, &ubike_digits_48, 8 );
+
+    lv_obj_align ( rpm_label.obj, LV_ALIGN_TOP_MID, 80, 60 );
+    lv_obj_align ( pwr_label.obj, LV_ALIGN_TOP_MID, -80, 60 );
+    lv_obj_align ( inc_label.obj, LV_ALIGN_TOP_MID, -80, 200 );
+    lv_obj_align ( res_label.obj, LV_ALIGN_TOP_MID, 80, 200 );
+    lv_obj_align ( swLabel.obj, LV_ALIGN_TOP_MID, 0, 328 );
+}
 
-    lv_style_init ( &style );
-    lv_style_set_text_font ( &style, &lv_font_montserrat_48 );
-    lv_obj_align ( rpm_label, LV_ALIGN_TOP_MID, 80, 60 );
-    lv_obj_add_style ( rpm_label, &style, 0 );
-    lv_obj_align ( pwr_label, LV_ALIGN_TOP_MID, -80, 60 );
-    lv_obj_add_style ( pwr_label, &style, 0 );
-    lv_obj_align ( inc_label, LV_ALIGN_TOP_MID, -80, 200 );
-    lv_obj_add_style ( inc_label, &style, 0 );
-    lv_obj_align ( res_label, LV_ALIGN_TOP_MID, 80, 200 );
-    lv_obj_add_style ( res_label, &style, 0 );
-    lv_obj_align ( swLabel, LV_ALIGN_TOP_MID, 0, 340 );
-    lv_obj_add_style ( swLabel, &style, 0 );
+static void createMain ( lv_obj_t *scr )
+{
+    drawLines ( scr );
+    drawLabels ( scr );
+    drawButton ( scr );
+    drawTrend ( scr );
+}
+
+static void updateMain ( const bike_data_t *data )
+{
+    updateLabels ( *data );
+}
+
+// Resident, the trend history and label model live with it
+const page_desc_t mainPage = { .title = NULL,
+                               .create = createMain,
+                               .update = updateMain,
+                               .resident = true };
+
+static uint32_t reDrawDisplay()
+{
+    static uint32_t lastSeq = 0;
+    k_spinlock_key_t key = k_spin_lock ( &dataLock );
+    const bike_data_t data = bikeData;
+    const uint32_t seq = dataSeq;
+    k_spin_unlock ( &dataLock, key );
+
+    // Trend history advances per sample, not per frame
+    if ( seq != lastSeq ) {
+        trendSample ( data );
+        summarySample ( data );
+        lastSeq = seq;
+    }
+
+    bool active = data.act_rpm > 0;
+    updateStopwatch ( active );
+
+    // Refresh is paused while asleep, the handler still polls touch
+    const bool wake = atomic_clear ( &wakeReq ) || active;
+    if ( displayPowerUpdate ( wake ) < DISP_ASLEEP ) {
+        pagesUpdate ( &data );
+    }
+
+    uint32_t ret;
+    {
+        PROFILE_SCOPE ( PROF_LV_TASK );
+        ret = lv_task_handler();
+    }
+    updateDisplayStats();
+    return ret;
+}
+
+// Touch rate while in use, otherwise as slow as LVGL allows, new
+// telemetry wakes the thread early
+static void displayThread ( void )
+{
+    uint32_t start_ms, wait_ms, elapsed_ms;
+    for ( ;; ) {
+        start_ms = k_uptime_get_32();
+        wait_ms = reDrawDisplay();
+
+        const uint32_t frame_ms
+            = lv_disp_get_inactive_time ( NULL ) < TOUCH_HOLD_MS
+                  ? FRAME_TOUCH_MS
+                  : FRAME_IDLE_MS;
+        wait_ms = CLAMP ( wait_ms, frame_ms, FRAME_MAX_MS );
+        elapsed_ms = k_uptime_get_32() - start_ms;
+        if ( elapsed_ms < wait_ms ) {
+            k_sem_take ( &data_sem, K_MSEC ( wait_ms - elapsed_ms ) );
+        }
+    }
 }
 
+K_THREAD_DEFINE ( display_thread_id,
+                  STACKSIZE,
+                  displayThread,
+                  NULL,
+                  NULL,
+                  NULL,
+                  PRIORITY,
+                  0,
+                  SYS_FOREVER_MS );
+
 int initDisplay()
 {
     static bool initialized = false;
@@ -351,90 +444,42 @@ int initDisplay()
         LOG_ERR ( "Display device not ready!" );
         return -1;
     }
-    if ( !device_is_ready ( blPwm.dev ) ) {
-        LOG_ERR ( "Backlight PWM device isn't ready!" );
+    if ( displayPowerInit ( display_dev ) ) {
         return -2;
     }
-    if ( pwm_set_dt ( &blPwm, PWM_PERIOD, PWM_PERIOD ) ) {
-        LOG_ERR ( "Failed to set backlight period!" );
-        return -3;
-    }
 
-    updateBacklight ( true );
+    struct display_capabilities caps;
+    display_get_capabilities ( display_dev, &caps );
+    bytesPerPx = caps.current_pixel_format == PIXEL_FORMAT_RGB_888 ? 3 : 2;
+    lv_disp_drv_t *drv = lv_disp_get_default()->driver;
+    drv->monitor_cb = monitorCb;
+    displayFlushInit ( drv );
 
-    drawLines();
-    drawLabels();
-    drawButton();
-    // drawSlider();
+    pagesInit();
 
-    // Semaphore default to taken
     bikeData.tgt_inc = 20;
     resetTime();
     updateLabels ( bikeData );
 
-    lv_obj_clear_flag ( lv_scr_act(), LV_OBJ_FLAG_SCROLLABLE );
-    lv_obj_add_event_cb ( lv_scr_act(), screenCb, LV_EVENT_PRESSED, NULL );
+    // Only clickable while asleep, so the wake touch goes nowhere else
+    lv_obj_add_event_cb ( lv_layer_top(), wakeCb, LV_EVENT_PRESSED, NULL );
 
     lv_task_handler();
     display_blanking_off ( display_dev );
 
-    k_sem_give ( &data_sem );
+    // LVGL belongs to the display thread from here on
+    k_thread_start ( display_thread_id );
     initialized = true;
     return 0;
 }
 
-static uint32_t reDrawDisplay()
-{
-    if ( k_sem_take ( &data_sem, SEM_TIMEOUT ) ) {
-        LOG_WRN ( "reDrawDisplay() - Failed to get display data semaphore!" );
-        return 500;
-    }
-
-    bool active = bikeData.act_rpm > 0;
-    updateBacklight ( active );
-    updateStopwatch ( active );
-    updateLabels ( bikeData );
-
-    uint32_t ret = lv_task_handler();
-
-    k_sem_give ( &data_sem );
-    return ret;
-}
-
+// Never waits on rendering, the display thread picks up the snapshot
 int updateDisplay ( bike_data_t data )
 {
-    // LOG_INF ("Updating display..." );
-    if ( k_sem_take ( &data_sem, SEM_TIMEOUT ) ) {
-        LOG_WRN ( "updateDisplay() - Failed to get display data semaphore!" );
-        return -1;
-    }
-
+    k_spinlock_key_t key = k_spin_lock ( &dataLock );
     bikeData = data;
-
+    dataSeq++;
+    k_spin_unlock ( &dataLock, key );
     k_sem_give ( &data_sem );
-    reDrawDisplay();
-    // LOG_INF ("Display updated!" );
     return 0;
 }
-
-/*static void displayThread ( void )
-{
-    k_sem_take ( &data_sem, K_FOREVER );  // Released by init
-    k_sem_give ( &data_sem );
-
-    uint32_t sleep_ms;
-    for ( ;; ) {
-        sleep_ms = reDrawDisplay();
-        k_msleep ( sleep_ms );
-    }
-}
-
-K_THREAD_DEFINE ( display_thread_id,
-                  STACKSIZE,
-                  displayThread,
-                  NULL,
-                  NULL,
-                  NULL,
-                  PRIORITY,
-                  0,
-                  0 );*/
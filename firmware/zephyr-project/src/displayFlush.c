@@ -0,0 +1,103 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "displayFlush.h"
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "profile.h"
+
+LOG_MODULE_REGISTER ( display_flush );
+
+typedef struct
+{
+    lv_disp_drv_t *drv;
+    lv_area_t area;  // LVGL reuses its copy for the next render
+    lv_color_t *buf;
+} flush_req_t;
+
+K_MSGQ_DEFINE ( flush_msgq, sizeof ( flush_req_t ), 1, 4 );
+K_SEM_DEFINE ( flush_done_sem, 0, 1 );
+static atomic_t pending = ATOMIC_INIT ( 0 );  // Queued or on the bus
+static void ( *driverFlush ) ( lv_disp_drv_t *drv,
+                               const lv_area_t *area,
+                               lv_color_t *buf );
+
+// Hands the buffer to the flush thread, LVGL carries on rendering the
+// next area into the other draw buffer
+static void flushCb ( lv_disp_drv_t *drv,
+                      const lv_area_t *area,
+                      lv_color_t *buf )
+{
+    flush_req_t req = { .drv = drv, .area = *area, .buf = buf };
+    atomic_inc ( &pending );
+    k_msgq_put ( &flush_msgq, &req, K_FOREVER );
+}
+
+// LVGL spins on this until the previous buffer is released
+static void waitCb ( lv_disp_drv_t *drv )
+{
+    k_sem_take ( &flush_done_sem, K_MSEC ( FLUSH_WAIT_MS ) );
+}
+
+static void flushThread ( void )
+{
+    flush_req_t req;
+    for ( ;; ) {
+        k_msgq_get ( &flush_msgq, &req, K_FOREVER );
+        {
+            // The SPIM EasyDMA end interrupt wakes us, the driver's flush
+            // then releases the buffer with lv_disp_flush_ready()
+            PROFILE_SCOPE ( PROF_FLUSH );
+            driverFlush ( req.drv, &req.area, req.buf );
+        }
+        atomic_dec ( &pending );
+        k_sem_give ( &flush_done_sem );
+    }
+}
+
+K_THREAD_DEFINE ( flush_thread_id,
+                  FLUSH_STACKSIZE,
+                  flushThread,
+                  NULL,
+                  NULL,
+                  NULL,
+                  FLUSH_PRIORITY,
+                  0,
+                  0 );
+
+bool displayFlushIdle()
+{
+    return !atomic_get ( &pending );
+}
+
+int displayFlushInit ( lv_disp_drv_t *drv )
+{
+    // With one buffer LVGL would only wait on the transfer anyway
+    if ( !drv->draw_buf->buf2 ) {
+        LOG_WRN ( "Single draw buffer, flushing synchronously" );
+        return -ENOTSUP;
+    }
+
+    driverFlush = drv->flush_cb;
+    drv->flush_cb = flushCb;
+    drv->wait_cb = waitCb;
+    return 0;
+}
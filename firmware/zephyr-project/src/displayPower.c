@@ -0,0 +1,171 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "displayPower.h"
+
+#include <lvgl.h>
+#include <zephyr/drivers/display.h>
+#include <zephyr/drivers/pwm.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+
+#include "displayFlush.h"
+
+LOG_MODULE_REGISTER ( display_power );
+
+#define BL_PWM_NODE DT_ALIAS ( blpwm )
+#define PWM_PERIOD PWM_MSEC ( 1U )  // 1 kHz
+#define DIM_MS 10000U               // 10s
+#define ASLEEP_MS 60000U            // 60s
+#define OFF_MS 600000U              // 10min
+#define RAMP_STEP_MS 10U
+#define RAMP_STEP_PCT 5U
+
+static const struct pwm_dt_spec blPwm = PWM_DT_SPEC_GET ( BL_PWM_NODE );
+static const struct device *panel;
+static const uint8_t levels [] = { [DISP_ACTIVE] = 100,
+                                   [DISP_DIM] = 10,
+                                   [DISP_ASLEEP] = 0,
+                                   [DISP_OFF] = 0 };
+static disp_power_t state = DISP_ACTIVE;
+static uint32_t lastActive_ms = 0;
+static bool blanked = false;
+#if defined( CONFIG_PM_DEVICE )
+static bool suspended = false;
+#endif
+static atomic_t blLevel = ATOMIC_INIT ( 0 );
+static atomic_t blTarget = ATOMIC_INIT ( 0 );
+
+static void set_backlight ( uint8_t pct )
+{
+    // Active low
+    pwm_set_dt ( &blPwm, PWM_PERIOD, ( PWM_PERIOD * ( 100 - pct ) ) / 100 );
+}
+
+// The PWM holds each step, the CPU only wakes to move to the next one
+static void ramp_handler ( struct k_work *work )
+{
+    const int level = atomic_get ( &blLevel );
+    const int target = atomic_get ( &blTarget );
+    if ( level == target ) {
+        return;
+    }
+
+    const int next = level < target ? MIN ( level + RAMP_STEP_PCT, target )
+                                    : MAX ( level - RAMP_STEP_PCT, target );
+    set_backlight ( next );
+    atomic_set ( &blLevel, next );
+    if ( next != target ) {
+        k_work_schedule ( k_work_delayable_from_work ( work ),
+                          K_MSEC ( RAMP_STEP_MS ) );
+    }
+}
+
+K_WORK_DELAYABLE_DEFINE ( ramp_work, ramp_handler );
+
+static void ramp_to ( uint8_t pct )
+{
+    atomic_set ( &blTarget, pct );
+    k_work_reschedule ( &ramp_work, K_NO_WAIT );
+}
+
+static void wake_panel()
+{
+#if defined( CONFIG_PM_DEVICE )
+    if ( suspended ) {
+        pm_device_action_run ( panel, PM_DEVICE_ACTION_RESUME );
+        suspended = false;
+    }
+#endif
+    if ( blanked ) {
+        display_blanking_off ( panel );
+        blanked = false;
+    }
+    lv_timer_resume ( lv_disp_get_default()->refr_timer );
+    lv_obj_invalidate ( lv_scr_act() );
+    lv_obj_clear_flag ( lv_layer_top(), LV_OBJ_FLAG_CLICKABLE );
+}
+
+static void suspend_rendering()
+{
+    lv_timer_pause ( lv_disp_get_default()->refr_timer );
+    // Swallows the touch that wakes the screen
+    lv_obj_add_flag ( lv_layer_top(), LV_OBJ_FLAG_CLICKABLE );
+}
+
+int displayPowerInit ( const struct device *dev )
+{
+    if ( !device_is_ready ( blPwm.dev ) ) {
+        LOG_ERR ( "Backlight PWM device isn't ready!" );
+        return -1;
+    }
+    if ( pwm_set_dt ( &blPwm, PWM_PERIOD, PWM_PERIOD ) ) {
+        LOG_ERR ( "Failed to set backlight period!" );
+        return -2;
+    }
+    panel = dev;
+    lastActive_ms = k_uptime_get_32();
+    ramp_to ( levels [DISP_ACTIVE] );
+    return 0;
+}
+
+// Display thread only, activity is touch, buttons or pedalling
+disp_power_t displayPowerUpdate ( bool activity )
+{
+    const uint32_t now_ms = k_uptime_get_32();
+    if ( activity ) {
+        lastActive_ms = now_ms;
+    }
+
+    const uint32_t idle_ms = now_ms - lastActive_ms;
+    disp_power_t next;
+    if ( idle_ms < DIM_MS ) {
+        next = DISP_ACTIVE;
+    } else if ( idle_ms < ASLEEP_MS ) {
+        next = DISP_DIM;
+    } else if ( idle_ms < OFF_MS ) {
+        next = DISP_ASLEEP;
+    } else {
+        next = DISP_OFF;
+    }
+
+    if ( next != state ) {
+        LOG_INF ( "Display power %d -> %d", state, next );
+        if ( next < DISP_ASLEEP && state >= DISP_ASLEEP ) {
+            wake_panel();
+        } else if ( next >= DISP_ASLEEP && state < DISP_ASLEEP ) {
+            suspend_rendering();
+        }
+        ramp_to ( levels [next] );
+        state = next;
+    }
+
+    // Panel goes dark once the backlight is down and the last frame is out
+    if ( state >= DISP_ASLEEP && !blanked && !atomic_get ( &blLevel )
+         && displayFlushIdle() ) {
+        display_blanking_on ( panel );
+        blanked = true;
+    }
+#if defined( CONFIG_PM_DEVICE )
+    if ( state == DISP_OFF && blanked && !suspended ) {
+        suspended = !pm_device_action_run ( panel, PM_DEVICE_ACTION_SUSPEND );
+    }
+#endif
+    return state;
+}
@@ -29,22 +29,28 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/types.h>
-#include <zephyr/kernel.h>
+
+#include "fecSchedule.h"
+#include "telemetry.h"
 
 #define TGT_CYCLE_MS 250
-#define STACKSIZE 512
-#define PRIORITY 7
+#define REQ_QUEUE_LEN 8
 #define TX_BUF_SIZE 50
 
 // Globals
 LOG_MODULE_REGISTER ( fec );
-static K_SEM_DEFINE ( ble_init_ok, 1, 1 );
-static bike_data_t bikeData = {};
-static fec_page_request_t reqPageData = {};
+static bike_data_t bikeData = {};  // Snapshot used while building a page
 static fec_command_status_data_t commandStatus
     = { 0x47, 0xFF, 0xFF, 0x00, 0x00000000, 0x00 };
 static set_targets_callback_t setTargetsCbFunc = NULL;
 
+// Requested pages are served ahead of the schedule
+K_MSGQ_DEFINE ( req_msgq, sizeof ( uint8_t ), REQ_QUEUE_LEN, 1 );
+static void page_work_handler ( struct k_work *work );
+static void page_timer_expiry ( struct k_timer *timer );
+K_WORK_DEFINE ( page_work, page_work_handler );
+K_TIMER_DEFINE ( page_timer, page_timer_expiry, NULL );
+
 void fecSetTargetsCb ( set_targets_callback_t func )
 {
     setTargetsCbFunc = func;
@@ -56,6 +62,15 @@ static void fec_notify_ccc_cfg_changed ( const struct bt_gatt_attr *attr,
 {
     bool notif_enabled = ( value == BT_GATT_CCC_NOTIFY );
 
+    // Pages are only built while someone is listening
+    if ( notif_enabled ) {
+        k_timer_start (
+            &page_timer, K_MSEC ( TGT_CYCLE_MS ), K_MSEC ( TGT_CYCLE_MS ) );
+    } else {
+        k_timer_stop ( &page_timer );
+        k_msgq_purge ( &req_msgq );
+    }
+
     LOG_INF ( "FE-C notifications %s", notif_enabled ? "enabled" : "disabled" );
 }
 
@@ -73,6 +88,15 @@ static uint8_t check_checksum ( uint8_t buf [], size_t len )
     return buf [len - 1] - get_checksum ( buf, len );
 }
 
+static void set_targets ( const bike_tgts_t tgts )
+{
+    if ( setTargetsCbFunc ) {
+        setTargetsCbFunc ( tgts );
+    } else {
+        LOG_ERR ( "Bike target callback not registered!" );
+    }
+}
+
 static void incCmdSeq()
 {
     if ( commandStatus.sequenceNum == 0xFE ) {
@@ -93,12 +117,12 @@ static ssize_t tx_cb ( struct bt_conn *conn,
     LOG_INF ( "TX callback, length %u", len );
     const tx_msg_t *msg = ( void * )( ( uint8_t * )buf + offset );
 
-    if ( check_checksum ( ( void * )msg, len ) ) {
-        LOG_ERR ( "Message received with bad checksum!" );
-        return -1;
-    } else if ( len < sizeof ( tx_msg_t ) + 2 ) {
+    if ( len < sizeof ( tx_msg_t ) + 2 ) {
         LOG_WRN ( "Message length too short: %u!", len );
         return len;
+    } else if ( check_checksum ( ( void * )msg, len ) ) {
+        LOG_ERR ( "Message received with bad checksum!" );
+        return BT_GATT_ERR ( BT_ATT_ERR_VALUE_NOT_ALLOWED );
     }
 
     // First byte of every data page is page number
@@ -117,8 +141,9 @@ static ssize_t tx_cb ( struct bt_conn *conn,
             commandStatus.data [1] = 0xFF;
             commandStatus.data [2] = 0xFF;
             commandStatus.data [3] = resCtrl->resistance;
-            // TODO
-            // setTargetsCbFunc();
+            set_targets ( ( bike_tgts_t ) { TGT_INC_INVALID,
+                                            resCtrl->resistance,
+                                            TGT_PWR_INVALID } );
             commandStatus.lastCmdId = FEC_CONTROL_SET_BASIC_RESISTANCE_PG;
             incCmdSeq();
             break;
@@ -134,8 +159,9 @@ static ssize_t tx_cb ( struct bt_conn *conn,
             commandStatus.data [1] = 0xFF;
             commandStatus.data [2] = pwrCtrl->tgtWatts & 0x00FF;
             commandStatus.data [3] = pwrCtrl->tgtWatts >> 8;
-            // TODO
-            // setTargetsCbFunc();
+            set_targets ( ( bike_tgts_t ) { TGT_INC_INVALID,
+                                            TGT_RES_INVALID,
+                                            pwrCtrl->tgtWatts / 4 } );
             commandStatus.lastCmdId = FEC_CONTROL_SET_TARGET_POWER_PG;
             incCmdSeq();
             break;
@@ -152,8 +178,7 @@ static ssize_t tx_cb ( struct bt_conn *conn,
             commandStatus.data [1] = windCtrl->Cw;
             commandStatus.data [2] = windCtrl->wind_kph;
             commandStatus.data [3] = windCtrl->draftFactor;
-            // TODO
-            // setTargetsCbFunc();
+            // Wind is not simulated, acknowledge only
             commandStatus.lastCmdId = FEC_CONTROL_SET_WIND_RESISTANCE_PG;
             incCmdSeq();
             break;
@@ -170,9 +195,15 @@ static ssize_t tx_cb ( struct bt_conn *conn,
             commandStatus.data [1] = trackCtrl->incline & 0x00FF;
             commandStatus.data [2] = trackCtrl->incline >> 8;
             commandStatus.data [3] = trackCtrl->Crr;
-            // TODO
-            // setTargetsCbFunc();
-            commandStatus.lastCmdId = FEC_CONTROL_SET_WIND_RESISTANCE_PG;
+            if ( ( uint16_t )trackCtrl->incline != 0xFFFF ) {
+                // Grade is offset by -200.00%
+                const int16_t grade = ( uint16_t )trackCtrl->incline - 20000;
+                set_targets ( ( bike_tgts_t ) { grade,
+                                                TGT_RES_INVALID,
+                                                TGT_PWR_INVALID,
+                                                true } );
+            }
+            commandStatus.lastCmdId = FEC_CONTROL_SET_TRACK_RESISTANCE_PG;
             incCmdSeq();
             break;
         case FEC_REQUEST_DATA_PAGE_PG:
@@ -180,8 +211,14 @@ static ssize_t tx_cb ( struct bt_conn *conn,
                 LOG_WRN ( "Data page request length too short: %u!", len );
                 break;
             }
-            memcpy ( &reqPageData, &msg->data, sizeof ( fec_page_request_t ) );
-            LOG_INF ( "Data page request: %02x!", reqPageData.reqPage );
+            const fec_page_request_t *req = ( void * )&msg->data;
+            LOG_INF ( "Data page request: %02x!", req->reqPage );
+            for ( int i = 0; i < req->reqCnt; i++ ) {
+                if ( k_msgq_put ( &req_msgq, &req->reqPage, K_NO_WAIT ) ) {
+                    LOG_WRN ( "Data page request queue full!" );
+                    break;
+                }
+            }
             break;
         default:
             LOG_WRN ( "Unknown data page: %02x!", page );
@@ -209,20 +246,6 @@ BT_GATT_SERVICE_DEFINE (
                              tx_cb,
                              NULL ) );
 
-static int fec_init ( const struct device *dev )
-{
-    ARG_UNUSED ( dev );
-
-    k_sem_give ( &ble_init_ok );
-
-    return 0;
-}
-
-void bt_fec_update ( bike_data_t data )
-{
-    bikeData = data;
-}
-
 static void set_checksum ( uint8_t buf [], size_t len )
 {
     buf [len - 1] = get_checksum ( buf, len );
@@ -246,7 +269,7 @@ static size_t set_general_data_page ( void *buf )
     // Update bike data
     data.page = FEC_GENERAL_FE_DATA_PG;
     data.equipment = STATIONARY_BIKE;
-    data.elapsedTime += 5;  // 0.25s
+    data.elapsedTime = k_uptime_get() / 250;  // 0.25s, rolls over
     data.distance += 1;     // meters
     data.speed = 0xFFFF;    // 0.001 m/s
     data.heartrate = 0xFF;  // bpm
@@ -427,25 +450,8 @@ static size_t set_capabilities_page ( void *buf )
     return msgSize;
 }
 
-static void send_pacer()
-{
-    static uint32_t last_ms = 0;
-    int64_t elapsed_ms = k_uptime_get_32() - last_ms;
-    if ( elapsed_ms < 0 ) {
-        elapsed_ms += 1LL << 32;
-    }
-    if ( elapsed_ms < TGT_CYCLE_MS ) {
-        k_msleep ( TGT_CYCLE_MS - elapsed_ms );
-    }
-    last_ms = k_uptime_get_32();
-}
-
 static void send_msg ( void *buf, size_t len )
 {
-    send_pacer();
-    /*uint8_t dataPage;
-    memcpy ( &dataPage, ( uint8_t * )buf + 4, sizeof ( uint8_t ) );
-    LOG_INF ( "Transmitting data page: %02x", dataPage );*/
     int rc = bt_gatt_notify_uuid ( NULL,
                                    BLE_UUID_FEC_RX_CHAR,
                                    fec_svc.attrs,
@@ -458,109 +464,61 @@ static void send_msg ( void *buf, size_t len )
     }
 }
 
-static void bt_fec_notify()
+typedef size_t ( *page_builder_t ) ( void *buf );
+
+typedef struct
 {
-    static uint8_t buf [TX_BUF_SIZE] = {};
-    int len = 0;
-    static int cnt = 0;
-    cnt++;
-
-    // First check for requests
-    for ( int i = 0; i < reqPageData.reqCnt; i++ ) {
-        switch ( reqPageData.reqPage ) {
-            case 0:
-                // Don't do anything, no request
-                break;
-            case FEC_GENERAL_FE_DATA_PG:
-                len = set_general_data_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            case FEC_GENERAL_SETTINGS_PG:
-                len = set_general_settings_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            case FEC_STATIONARY_BIKE_DATA_PG:
-                len = set_bike_data_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            case FEC_COMMAND_STATUS_PG:
-                len = set_command_status_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            case FEC_COMMON_MANUFACTURER_IDENT_PG:
-                len = set_manufacturer_id_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            case FEC_COMMON_PRODUCT_INFORMATION_PG:
-                len = set_product_info_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            case FEC_COMMON_FE_CAPABILITIES_PG:
-                len = set_capabilities_page ( &buf );
-                send_msg ( buf, len );
-                break;
-            default:
-                LOG_WRN ( "Unknown data page request: %02x!",
-                          reqPageData.reqPage );
+    uint8_t page;
+    page_builder_t build;
+} fec_page_builder_t;
+
+static const fec_page_builder_t builders []
+    = { { FEC_GENERAL_FE_DATA_PG, set_general_data_page },
+        { FEC_GENERAL_SETTINGS_PG, set_general_settings_page },
+        { FEC_STATIONARY_BIKE_DATA_PG, set_bike_data_page },
+        { FEC_COMMAND_STATUS_PG, set_command_status_page },
+        { FEC_COMMON_MANUFACTURER_IDENT_PG, set_manufacturer_id_page },
+        { FEC_COMMON_PRODUCT_INFORMATION_PG, set_product_info_page },
+        { FEC_COMMON_FE_CAPABILITIES_PG, set_capabilities_page } };
+
+static uint8_t next_scheduled_page()
+{
+    static uint16_t cnt = 0;
+    const uint8_t page = fecScheduledPage ( cnt );
+    cnt = ( cnt + 1 ) % FEC_SCHEDULE_LEN;
+    return page;
+}
+
+static size_t build_page ( uint8_t page, void *buf )
+{
+    for ( int i = 0; i < ARRAY_SIZE ( builders ); i++ ) {
+        if ( builders [i].page == page ) {
+            return builders [i].build ( buf );
         }
     }
-    memset ( &reqPageData, 0, sizeof ( fec_page_request_t ) );
-
-    /*
-     * 10.1.1 - Minimum Data Page Requirements
-     *     FEC_GENERAL_FE_DATA_PG: 2 Hz - 2x (consecutive) per sec or every 5th
-     *     FEC_GENERAL_SETTINGS_PG = 0.2 Hz - At least once every 20 messages
-     *     FEC_STATIONARY_BIKE_DATA_PG: 0.8 Hz - At least once every 5 messages
-     *     FEC_COMMAND_STATUS_PG: On request
-     *     FEC_COMMON_MANUFACTURER_IDENT_PG: 2x (consecutive) every 132 messages
-     *     FEC_COMMON_PRODUCT_INFORMATION_PG: 2x (consecutive) every 132
-     *         messages
-     *     FEC_COMMON_FE_CAPABILITIES_PG: On request
-     */
-    if ( cnt % 132 == 0 ) {
-        len = set_manufacturer_id_page ( &buf );
-        send_msg ( buf, len );
-        cnt++;
-        len = set_manufacturer_id_page ( &buf );
-        send_msg ( buf, len );
-        cnt++;
-        len = set_product_info_page ( &buf );
-        send_msg ( buf, len );
-        cnt++;
-        len = set_product_info_page ( &buf );
-        send_msg ( buf, len );
-    } else if ( cnt % 20 == 2 ) {
-        len = set_general_settings_page ( &buf );
-        send_msg ( buf, len );
-    } else if ( cnt % 5 == 0 ) {
-        len = set_general_data_page ( &buf );
-        send_msg ( buf, len );
-        cnt++;
-        len = set_general_data_page ( &buf );
-        send_msg ( buf, len );
-    } else {
-        len = set_bike_data_page ( &buf );
-        send_msg ( buf, len );
-    }
+    LOG_WRN ( "Unknown data page request: %02x!", page );
+    return 0;
 }
 
-static void ble_fec_notify_thread ( void )
+static void page_work_handler ( struct k_work *work )
 {
-    k_sem_take ( &ble_init_ok, K_FOREVER );
+    ARG_UNUSED ( work );
+    static uint8_t buf [TX_BUF_SIZE] = {};
 
-    for ( ;; ) {
-        bt_fec_notify();
+    telemetryGetSample ( &bikeData );
+
+    uint8_t page;
+    if ( k_msgq_get ( &req_msgq, &page, K_NO_WAIT ) ) {
+        page = next_scheduled_page();
+    }
+    const size_t len = build_page ( page, buf );
+    if ( len ) {
+        send_msg ( buf, len );
     }
 }
 
-/*K_THREAD_DEFINE ( ble_fec_notify_thread_id,
-                  STACKSIZE,
-                  ble_fec_notify_thread,
-                  NULL,
-                  NULL,
-                  NULL,
-                  PRIORITY,
-                  0,
-                  5000 );
-
-SYS_INIT ( fec_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );*/
+static void page_timer_expiry ( struct k_timer *timer )
+{
+    ARG_UNUSED ( timer );
+    k_work_submit ( &page_work );
+}
@@ -0,0 +1,67 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fecSchedule.h"
+
+#include <zephyr/sys/util.h>
+
+#include "fec.h"
+
+/*
+ * 10.1.1 - Minimum Data Page Requirements
+ *     FEC_GENERAL_FE_DATA_PG: 2 Hz - 2x (consecutive) per sec or every 5th
+ *     FEC_GENERAL_SETTINGS_PG = 0.2 Hz - At least once every 20 messages
+ *     FEC_STATIONARY_BIKE_DATA_PG: 0.8 Hz - At least once every 5 messages
+ *     FEC_COMMAND_STATUS_PG: On request
+ *     FEC_COMMON_MANUFACTURER_IDENT_PG: 2x (consecutive) every 132 messages
+ *     FEC_COMMON_PRODUCT_INFORMATION_PG: 2x (consecutive) every 132
+ *         messages
+ *     FEC_COMMON_FE_CAPABILITIES_PG: On request
+ *
+ * Every block of 5 starts with two general data pages followed by three
+ * bike data slots.  Settings take the last slot of every 4th block and
+ * the common pages the middle two of blocks 2 and 3, so windows never
+ * overlap and no page is displaced.  The common pages repeat every 120
+ * messages, inside the 132 limit and a multiple of the other periods.
+ * tests/fecSchedule checks the gaps.
+ */
+typedef struct
+{
+    uint8_t page;
+    uint8_t period;  // Messages
+    uint8_t offset;  // Start of window within period
+    uint8_t count;   // Consecutive messages in window
+} fec_schedule_t;
+
+static const fec_schedule_t schedule []
+    = { { FEC_GENERAL_FE_DATA_PG, 5, 0, 2 },
+        { FEC_COMMON_MANUFACTURER_IDENT_PG, FEC_SCHEDULE_LEN, 12, 2 },
+        { FEC_COMMON_PRODUCT_INFORMATION_PG, FEC_SCHEDULE_LEN, 17, 2 },
+        { FEC_GENERAL_SETTINGS_PG, 20, 4, 1 } };
+
+uint8_t fecScheduledPage ( uint16_t cnt )
+{
+    for ( int i = 0; i < ARRAY_SIZE ( schedule ); i++ ) {
+        const uint8_t pos = cnt % schedule [i].period;
+        if ( pos >= schedule [i].offset
+             && pos < schedule [i].offset + schedule [i].count ) {
+            return schedule [i].page;
+        }
+    }
+    return FEC_STATIONARY_BIKE_DATA_PG;
+}
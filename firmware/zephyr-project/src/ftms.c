@@ -28,30 +28,78 @@
 #include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/types.h>
 
-#define SEM_TIMEOUT K_MSEC ( 500 )
+#include "telemetry.h"
+
+#define CTRL_QUEUE_LEN 4
+#define CTRL_STACKSIZE 1024
+#define CTRL_PRIORITY 10
+#define IND_TIMEOUT K_MSEC ( 500 )
 
 LOG_MODULE_REGISTER ( ftms );
 static set_targets_callback_t setTargetsCbFunc = NULL;
-static bool ftms_bike_notify = false;
+static ctrl_activity_callback_t activityCbFunc = NULL;
 static bool ftms_status_notify = false;
-static bool ftms_control_notify = false;
-K_SEM_DEFINE ( ftms_sem, 0, 1 );
+
+// Control point writes are queued here and handled off the BT RX thread
+typedef struct
+{
+    struct bt_conn *conn;
+    uint16_t len;
+    uint8_t data [CTRL_POINT_MAX_LEN];
+} ctrl_point_cmd_t;
+
+K_MSGQ_DEFINE ( ctrl_msgq, sizeof ( ctrl_point_cmd_t ), CTRL_QUEUE_LEN, 4 );
+K_THREAD_STACK_DEFINE ( ctrl_stack, CTRL_STACKSIZE );
+K_SEM_DEFINE ( ind_sem, 1, 1 );
+static struct k_work_q ctrl_work_q;
+static struct k_work ctrl_work;
+static struct k_spinlock ctrl_lock;
+static struct bt_conn *ctrl_conn = NULL;  // Client granted control
+static struct bt_gatt_indicate_params ind_params;
+static ctrl_point_resp_t ind_resp;
+
+// Machine state, notified only on transitions
+typedef struct
+{
+    ftms_status_t msg;
+    uint16_t len;  // 0 when there is nothing to send
+    ble_ftms_training_status_t training;
+    bool trainingChanged;
+} status_evt_t;
+
+K_MUTEX_DEFINE ( state_mutex );
+static ftms_state_t ftms_state = FTMS_IDLE;
+static bool user_hold = false;  // Stopped or paused from the control point
+static uint32_t last_pedal_ms = 0;
+static ble_ftms_training_status_t training_status
+    = { .flags = 0, .status = TRAINING_STATUS_IDLE };
 
 void ftmsSetTargetsCb ( set_targets_callback_t func )
 {
     setTargetsCbFunc = func;
 }
 
+void ftmsSetActivityCb ( ctrl_activity_callback_t func )
+{
+    activityCbFunc = func;
+}
+
 // Config change callback
 static void ftms_bike_data_ccc_changed ( const struct bt_gatt_attr *attr,
                                          uint16_t value )
 {
-    ftms_bike_notify = ( value == BT_GATT_CCC_NOTIFY );
-
     LOG_INF ( "FTMS bike data notifications %s",
-              ftms_bike_notify ? "enabled" : "disabled" );
+              value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled" );
+}
+
+static void ftms_training_ccc_changed ( const struct bt_gatt_attr *attr,
+                                        uint16_t value )
+{
+    LOG_INF ( "FTMS training status notifications %s",
+              value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled" );
 }
 
 static void ftms_status_ccc_changed ( const struct bt_gatt_attr *attr,
@@ -66,10 +114,23 @@ static void ftms_status_ccc_changed ( const struct bt_gatt_attr *attr,
 static void ftms_control_ccc_changed ( const struct bt_gatt_attr *attr,
                                        uint16_t value )
 {
-    ftms_control_notify = ( value == BT_GATT_CCC_NOTIFY );
+    LOG_INF ( "FTMS control point indications %s",
+              value == BT_GATT_CCC_INDICATE ? "enabled" : "disabled" );
+}
 
-    LOG_INF ( "FTMS control point notifications %s",
-              ftms_control_notify ? "enabled" : "disabled" );
+static ssize_t read_training_status ( struct bt_conn *conn,
+                                     const struct bt_gatt_attr *attr,
+                                     void *buf,
+                                     uint16_t len,
+                                     uint16_t offset )
+{
+    return bt_gatt_attr_read ( conn,
+                               attr,
+                               buf,
+                               len,
+                               offset,
+                               &training_status,
+                               sizeof ( training_status ) );
 }
 
 static ble_ftms_features_t ftms_features;
@@ -120,12 +181,6 @@ static ssize_t read_res_range ( struct bt_conn *conn,
                                sizeof ( res_range_data ) );
 }
 
-static void control_response ( struct bt_conn *conn,
-                               const struct bt_gatt_attr *attr,
-                               uint8_t req_op,
-                               const void *data,
-                               uint16_t data_len );
-
 static ssize_t write_control ( struct bt_conn *conn,
                                const struct bt_gatt_attr *attr,
                                const void *buf,
@@ -133,54 +188,25 @@ static ssize_t write_control ( struct bt_conn *conn,
                                uint16_t offset,
                                uint8_t flags )
 {
-    // Lock semaphore to prevent notifications before response
-    if ( k_sem_take ( &ftms_sem, SEM_TIMEOUT ) ) {
-        LOG_WRN ( "Failed to get FTMS semaphore!  Continuing anyways..." );
-    }
-
-    const ctrl_point_req_t *req = buf;
     if ( offset ) {
-        k_sem_give ( &ftms_sem );
         return BT_GATT_ERR ( BT_ATT_ERR_INVALID_OFFSET );
     }
-    const uint16_t data_len = len - sizeof ( ctrl_point_req_t );
-
-    switch ( req->req_op ) {
-        case OPCODE_REQUEST:
-        case OPCODE_RESET:
-        case OPCODE_SET_INC:
-        case OPCODE_SET_RES:
-        case OPCODE_START:
-            control_response ( conn, attr, req->req_op, &req->param, data_len );
-            break;
-        case OPCODE_SIM_PARAMS: {
-            if ( data_len != sizeof ( sim_data_param_t ) ) {
-                LOG_ERR ( "Wrong length for bike sim parameters!\n" );
-                break;
-            }
-            sim_data_param_t *sim_data = ( void * )&req->param;
-            /*LOG_INF ( "Params: %d,%d,%u,%u",
-                      sim_data->wind_mps,
-                      sim_data->grade_hundredths_pct,
-                      sim_data->Crr,
-                      sim_data->Cw );*/
-            bike_tgts_t tgts = { sim_data->grade_hundredths_pct, 0xFF };
-            if ( setTargetsCbFunc ) {
-                setTargetsCbFunc ( tgts );
-            } else {
-                LOG_ERR ( "Bike target callback not registered!" );
-            }
-            control_response ( conn, attr, req->req_op, &req->param, data_len );
-            break;
-        }
-        default:
-            LOG_WRN ( "Unknown opcode: %x!\n", req->req_op );
-            // TODO - Return failure
-            control_response ( conn, attr, req->req_op, &req->param, data_len );
+    if ( !len || len > CTRL_POINT_MAX_LEN ) {
+        return BT_GATT_ERR ( BT_ATT_ERR_INVALID_ATTRIBUTE_LEN );
+    }
+    if ( !bt_gatt_is_subscribed ( conn, attr, BT_GATT_CCC_INDICATE ) ) {
+        return BT_GATT_ERR ( BT_ATT_ERR_CCC_IMPROPER_CONF );
     }
 
-    // Give up semaphore
-    k_sem_give ( &ftms_sem );
+    // Queue the request, it's validated and answered by the work queue
+    ctrl_point_cmd_t cmd = { .conn = bt_conn_ref ( conn ), .len = len };
+    memcpy ( cmd.data, buf, len );
+    if ( k_msgq_put ( &ctrl_msgq, &cmd, K_NO_WAIT ) ) {
+        bt_conn_unref ( cmd.conn );
+        LOG_WRN ( "Control point queue full!" );
+        return BT_GATT_ERR ( BT_ATT_ERR_PROCEDURE_IN_PROGRESS );
+    }
+    k_work_submit_to_queue ( &ctrl_work_q, &ctrl_work );
 
     return len;
 }
@@ -203,6 +229,14 @@ BT_GATT_SERVICE_DEFINE (
                              NULL ),
     BT_GATT_CCC ( ftms_bike_data_ccc_changed,
                   ( BT_GATT_PERM_READ | BT_GATT_PERM_WRITE ) ),
+    BT_GATT_CHARACTERISTIC ( BLE_UUID_TRAINING_STATUS_CHAR,
+                             BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                             BT_GATT_PERM_READ,
+                             read_training_status,
+                             NULL,
+                             NULL ),
+    BT_GATT_CCC ( ftms_training_ccc_changed,
+                  ( BT_GATT_PERM_READ | BT_GATT_PERM_WRITE ) ),
     BT_GATT_CHARACTERISTIC ( BLUE_UUID_SUPPORTED_INCLINATION_RANGE_CHAR,
                              BT_GATT_CHRC_READ,
                              BT_GATT_PERM_READ,
@@ -216,7 +250,7 @@ BT_GATT_SERVICE_DEFINE (
                              NULL,
                              NULL ),
     BT_GATT_CHARACTERISTIC ( BLUE_UUID_FITNESS_CONTROL_POINT_CHAR,
-                             BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+                             BT_GATT_CHRC_WRITE | BT_GATT_CHRC_INDICATE,
                              BT_GATT_PERM_WRITE,
                              NULL,
                              write_control,
@@ -232,34 +266,328 @@ BT_GATT_SERVICE_DEFINE (
     BT_GATT_CCC ( ftms_status_ccc_changed,
                   ( BT_GATT_PERM_READ | BT_GATT_PERM_WRITE ) ), );
 
+static void indicate_destroy ( struct bt_gatt_indicate_params *params )
+{
+    ARG_UNUSED ( params );
+    k_sem_give ( &ind_sem );
+}
+
 static void control_response ( struct bt_conn *conn,
-                               const struct bt_gatt_attr *attr,
                                uint8_t req_op,
-                               const void *data,
-                               uint16_t data_len )
+                               uint8_t result )
+{
+    // Only one indication may be in flight, params must stay valid until then
+    if ( k_sem_take ( &ind_sem, IND_TIMEOUT ) ) {
+        LOG_WRN ( "Previous indication unconfirmed, dropping response!" );
+        return;
+    }
+
+    ind_resp.resp_op = OPCODE_RESPONSE;
+    ind_resp.req_op = req_op;
+    ind_resp.result = result;
+
+    memset ( &ind_params, 0, sizeof ( ind_params ) );
+    ind_params.uuid = BLUE_UUID_FITNESS_CONTROL_POINT_CHAR;
+    ind_params.attr = ftms_svc.attrs;
+    ind_params.data = &ind_resp;
+    ind_params.len = sizeof ( ind_resp );
+    ind_params.destroy = indicate_destroy;
+    int rc = bt_gatt_indicate ( conn, &ind_params );
+    if ( rc ) {
+        k_sem_give ( &ind_sem );
+        LOG_ERR ( "Failed to indicate control point response: %d", rc );
+    }
+}
+
+static void status_notify ( const status_evt_t *evt )
+{
+    int rc;
+    if ( evt->len && ftms_status_notify ) {
+        rc = bt_gatt_notify_uuid ( NULL,
+                                   BLE_UUID_FTMS_STATUS_CHAR,
+                                   ftms_svc.attrs,
+                                   &evt->msg,
+                                   evt->len );
+        if ( rc && rc != -ENOTCONN ) {
+            LOG_WRN ( "Failed to notify machine status: %d", rc );
+        }
+    }
+
+    if ( evt->trainingChanged ) {
+        rc = bt_gatt_notify_uuid ( NULL,
+                                   BLE_UUID_TRAINING_STATUS_CHAR,
+                                   ftms_svc.attrs,
+                                   &evt->training,
+                                   sizeof ( evt->training ) );
+        if ( rc && rc != -ENOTCONN ) {
+            LOG_WRN ( "Failed to notify training status: %d", rc );
+        }
+    }
+}
+
+static void set_status ( status_evt_t *evt,
+                         uint8_t op,
+                         const void *param,
+                         uint16_t len )
+{
+    len = MIN ( len, STATUS_PARAM_MAX );
+    evt->msg.op = op;
+    if ( len ) {
+        memcpy ( evt->msg.param, param, len );
+    }
+    evt->len = sizeof ( evt->msg.op ) + len;
+}
+
+// Caller holds state_mutex and sends evt once it's released
+static void transition ( ftms_state_t state, bool hold, status_evt_t *evt )
 {
-    if ( !ftms_bike_notify ) {
-        LOG_ERR ( "Control point notifications not enabled!" );
+    const ftms_state_t prev = ftms_state;
+    user_hold = hold;
+    if ( state == prev ) {
         return;
     }
+    ftms_state = state;
+    LOG_INF ( "FTMS state %d -> %d", prev, state );
 
-    ctrl_point_resp_t *resp;
-    uint8_t buf [sizeof ( ctrl_point_resp_t ) + data_len];
+    uint8_t param;
+    switch ( state ) {
+        case FTMS_STARTED:
+            set_status ( evt, STATUS_STARTED, NULL, 0 );
+            break;
+        case FTMS_PAUSED:
+            param = STOP_PARAM_PAUSE;
+            set_status ( evt, STATUS_STOPPED, &param, sizeof ( param ) );
+            break;
+        case FTMS_STOPPED:
+            param = STOP_PARAM_STOP;
+            set_status ( evt, STATUS_STOPPED, &param, sizeof ( param ) );
+            break;
+        default:
+            set_status ( evt, STATUS_RESET, NULL, 0 );
+            break;
+    }
 
-    resp = ( void * )buf;
-    resp->resp_op = OPCODE_RESPONSE;
-    resp->req_op = req_op;
-    resp->result = OPCODE_SUCCESS;
-    if ( data && data_len ) {
-        memcpy ( &resp->param, data, data_len );
+    const uint8_t training = state == FTMS_STARTED ? TRAINING_STATUS_MANUAL
+                                                   : TRAINING_STATUS_IDLE;
+    if ( training == training_status.status ) {
+        return;
     }
-    bt_gatt_notify_uuid ( conn,
-                          BLUE_UUID_FITNESS_CONTROL_POINT_CHAR,
-                          attr,
-                          buf,
-                          sizeof ( buf ) );
+    training_status.status = training;
+    evt->training = training_status;
+    evt->trainingChanged = true;
+}
+
+static uint8_t control_state ( ftms_state_t state,
+                               bool hold,
+                               status_evt_t *evt )
+{
+    k_mutex_lock ( &state_mutex, K_FOREVER );
+    transition ( state, hold, evt );
+    k_mutex_unlock ( &state_mutex );
+    return OPCODE_SUCCESS;
+}
+
+static bool has_control ( struct bt_conn *conn )
+{
+    k_spinlock_key_t key = k_spin_lock ( &ctrl_lock );
+    bool ret = ( ctrl_conn == conn );
+    k_spin_unlock ( &ctrl_lock, key );
+    return ret;
 }
 
+static uint8_t request_control ( struct bt_conn *conn )
+{
+    uint8_t result = OPCODE_SUCCESS;
+    k_spinlock_key_t key = k_spin_lock ( &ctrl_lock );
+    if ( !ctrl_conn ) {
+        ctrl_conn = bt_conn_ref ( conn );
+    } else if ( ctrl_conn != conn ) {
+        result = OPCODE_NOT_PERMITTED;
+    }
+    k_spin_unlock ( &ctrl_lock, key );
+    return result;
+}
+
+static void release_control ( struct bt_conn *conn )
+{
+    struct bt_conn *released = NULL;
+    k_spinlock_key_t key = k_spin_lock ( &ctrl_lock );
+    if ( ctrl_conn == conn ) {
+        released = ctrl_conn;
+        ctrl_conn = NULL;
+    }
+    k_spin_unlock ( &ctrl_lock, key );
+    if ( released ) {
+        bt_conn_unref ( released );
+    }
+}
+
+static uint8_t apply_targets ( const bike_tgts_t tgts )
+{
+    if ( !setTargetsCbFunc ) {
+        LOG_ERR ( "Bike target callback not registered!" );
+        return OPCODE_FAILED;
+    }
+    setTargetsCbFunc ( tgts );
+    return OPCODE_SUCCESS;
+}
+
+static uint8_t handle_control ( struct bt_conn *conn,
+                                const ctrl_point_req_t *req,
+                                uint16_t data_len,
+                                status_evt_t *evt )
+{
+    uint8_t result;
+
+    switch ( req->req_op ) {
+        case OPCODE_REQUEST:
+            if ( data_len ) {
+                return OPCODE_INVALID_PARAM;
+            }
+            return request_control ( conn );
+        case OPCODE_RESET:
+            if ( !has_control ( conn ) ) {
+                return OPCODE_NOT_PERMITTED;
+            }
+            release_control ( conn );
+            control_state ( FTMS_IDLE, false, evt );
+            set_status ( evt, STATUS_RESET, NULL, 0 );
+            return OPCODE_SUCCESS;
+        case OPCODE_START:
+            if ( !has_control ( conn ) ) {
+                return OPCODE_NOT_PERMITTED;
+            }
+            return control_state ( FTMS_STARTED, false, evt );
+        case OPCODE_STOP:
+            if ( !has_control ( conn ) ) {
+                return OPCODE_NOT_PERMITTED;
+            }
+            if ( data_len != sizeof ( uint8_t ) ) {
+                return OPCODE_INVALID_PARAM;
+            }
+            if ( req->param [0] == STOP_PARAM_STOP ) {
+                return control_state ( FTMS_STOPPED, true, evt );
+            }
+            if ( req->param [0] == STOP_PARAM_PAUSE ) {
+                return control_state ( FTMS_PAUSED, true, evt );
+            }
+            return OPCODE_INVALID_PARAM;
+        case OPCODE_SET_INC: {
+            if ( !has_control ( conn ) ) {
+                return OPCODE_NOT_PERMITTED;
+            }
+            if ( data_len != sizeof ( int16_t ) ) {
+                return OPCODE_INVALID_PARAM;
+            }
+            const int16_t inc_tenth_pct = sys_get_le16 ( req->param );
+            if ( inc_tenth_pct < inc_range_data.min_tenth_pct
+                 || inc_tenth_pct > inc_range_data.max_tenth_pct ) {
+                return OPCODE_INVALID_PARAM;
+            }
+            bike_tgts_t tgts
+                = { 10 * inc_tenth_pct, TGT_RES_INVALID, TGT_PWR_INVALID };
+            result = apply_targets ( tgts );
+            if ( result == OPCODE_SUCCESS ) {
+                set_status ( evt, STATUS_TGT_INC, req->param, data_len );
+            }
+            return result;
+        }
+        case OPCODE_SET_RES: {
+            if ( !has_control ( conn ) ) {
+                return OPCODE_NOT_PERMITTED;
+            }
+            if ( data_len != sizeof ( uint8_t ) ) {
+                return OPCODE_INVALID_PARAM;
+            }
+            const uint8_t level = req->param [0];
+            if ( level < res_range_data.min_cnt
+                 || level > res_range_data.max_cnt ) {
+                return OPCODE_INVALID_PARAM;
+            }
+            // Scale supported level range to 0.5% units
+            bike_tgts_t tgts
+                = { TGT_INC_INVALID,
+                    ( level - res_range_data.min_cnt ) * 200
+                        / ( res_range_data.max_cnt - res_range_data.min_cnt ),
+                    TGT_PWR_INVALID };
+            result = apply_targets ( tgts );
+            if ( result == OPCODE_SUCCESS ) {
+                set_status ( evt, STATUS_TGT_RES, req->param, data_len );
+            }
+            return result;
+        }
+        case OPCODE_SIM_PARAMS: {
+            if ( !has_control ( conn ) ) {
+                return OPCODE_NOT_PERMITTED;
+            }
+            if ( data_len != sizeof ( sim_data_param_t ) ) {
+                LOG_ERR ( "Wrong length for bike sim parameters!" );
+                return OPCODE_INVALID_PARAM;
+            }
+            const sim_data_param_t *sim_data = ( void * )req->param;
+            bike_tgts_t tgts
+                = { sys_le16_to_cpu ( sim_data->grade_hundredths_pct ),
+                    TGT_RES_INVALID,
+                    TGT_PWR_INVALID,
+                    true };
+            result = apply_targets ( tgts );
+            if ( result == OPCODE_SUCCESS ) {
+                set_status ( evt, STATUS_SIM_PARAMS, req->param, data_len );
+            }
+            return result;
+        }
+        default:
+            LOG_WRN ( "Unknown opcode: %x!", req->req_op );
+            return OPCODE_NOT_SUPPORTED;
+    }
+}
+
+static void ctrl_work_handler ( struct k_work *work )
+{
+    ARG_UNUSED ( work );
+
+    ctrl_point_cmd_t cmd;
+    while ( !k_msgq_get ( &ctrl_msgq, &cmd, K_NO_WAIT ) ) {
+        if ( activityCbFunc ) {
+            activityCbFunc ( cmd.conn );
+        }
+        const ctrl_point_req_t *req = ( void * )cmd.data;
+        status_evt_t evt = { .len = 0 };
+        const uint8_t result = handle_control (
+            cmd.conn, req, cmd.len - sizeof ( ctrl_point_req_t ), &evt );
+        control_response ( cmd.conn, req->req_op, result );
+        bt_conn_unref ( cmd.conn );
+
+        // Status follows the response to the procedure that caused it
+        status_notify ( &evt );
+    }
+}
+
+static void ftms_disconnected ( struct bt_conn *conn, uint8_t reason )
+{
+    ARG_UNUSED ( reason );
+    release_control ( conn );
+}
+
+BT_CONN_CB_DEFINE ( ftms_conn_callbacks )
+    = { .disconnected = ftms_disconnected };
+
+static size_t encode_bike_data ( const bike_data_t *bikeData, void *buf )
+{
+    ble_ftms_indoor_bike_data_t *data = buf;
+    data->flags = BLE_FTMS_INDOOR_FLAGS_FIELD_INSTANTANEOUS_CADENCE_PRESENT
+                  | BLE_FTMS_INDOOR_FLAGS_FIELD_INSTANTANEOUS_POWER_PRESENT;
+    data->InstantaneousSpeed = 0;
+    data->InstantaneousCadence = 2 * bikeData->act_rpm;
+    data->InstantaneousPower = bikeData->watts;
+    return sizeof ( ble_ftms_indoor_bike_data_t );
+}
+
+TELEMETRY_FRAME_DEFINE ( ftms_frame,
+                         ftms_svc,
+                         BLE_UUID_INDOOR_BIKE_DATA_CHAR,
+                         encode_bike_data );
+
 static int ftms_init ( const struct device *dev )
 {
     ARG_UNUSED ( dev );
@@ -281,66 +609,36 @@ static int ftms_init ( const struct device *dev )
     res_range_data.max_cnt = 22;
     res_range_data.min_cnt = 1;
 
-    LOG_INF ( "FTMS initialized" );
-
-    return 0;
-}
-
-int bt_ftms_bike_notify ( bike_data_t bikeData )
-{
-    if ( !ftms_bike_notify ) {
-        return -EACCES;
-    }
-
-    // Lock semaphore
-    if ( k_sem_take ( &ftms_sem, SEM_TIMEOUT ) ) {
-        LOG_WRN ( "Failed to get FTMS semaphore!  Continuing anyways..." );
-    }
+    k_work_queue_start ( &ctrl_work_q,
+                         ctrl_stack,
+                         K_THREAD_STACK_SIZEOF ( ctrl_stack ),
+                         CTRL_PRIORITY,
+                         NULL );
+    k_work_init ( &ctrl_work, ctrl_work_handler );
 
-    static ble_ftms_indoor_bike_data_t data = {};
-    data.flags = BLE_FTMS_INDOOR_FLAGS_FIELD_INSTANTANEOUS_CADENCE_PRESENT
-                 | BLE_FTMS_INDOOR_FLAGS_FIELD_INSTANTANEOUS_POWER_PRESENT;
-    data.InstantaneousCadence = 2 * bikeData.act_rpm;
-    data.InstantaneousPower = bikeData.watts;
-
-    int rc;
-    rc = bt_gatt_notify_uuid ( NULL,
-                               BLE_UUID_INDOOR_BIKE_DATA_CHAR,
-                               ftms_svc.attrs,
-                               &data,
-                               sizeof ( data ) );
-
-    // Give up semaphore
-    k_sem_give ( &ftms_sem );
+    LOG_INF ( "FTMS initialized" );
 
-    return rc == -ENOTCONN ? 0 : rc;
+    return telemetryRegister ( &ftms_frame );
 }
 
-int bt_ftms_status_notify()
+void bt_ftms_status_update ( bike_data_t data )
 {
-    if ( !ftms_status_notify ) {
-        return -EACCES;
-    }
-
-    // Lock semaphore
-    if ( k_sem_take ( &ftms_sem, SEM_TIMEOUT ) ) {
-        LOG_WRN ( "Failed to get FTMS semaphore!  Continuing anyways..." );
+    status_evt_t evt = { .len = 0 };
+    const uint32_t now_ms = k_uptime_get_32();
+
+    k_mutex_lock ( &state_mutex, K_FOREVER );
+    if ( data.act_rpm ) {
+        last_pedal_ms = now_ms;
+        if ( ftms_state != FTMS_STARTED && !user_hold ) {
+            transition ( FTMS_STARTED, false, &evt );
+        }
+    } else if ( ftms_state == FTMS_STARTED
+                && now_ms - last_pedal_ms >= FTMS_PAUSE_AFTER_MS ) {
+        transition ( FTMS_PAUSED, false, &evt );
     }
+    k_mutex_unlock ( &state_mutex );
 
-    int rc;
-    ftms_status_t status = {};
-    status.op = OPCODE_STARTED;
-
-    rc = bt_gatt_notify_uuid ( NULL,
-                               BLE_UUID_FTMS_STATUS_CHAR,
-                               ftms_svc.attrs,
-                               &status,
-                               sizeof ( status ) );  // TODO - Size is wrong!
-
-    // Give up semaphore
-    k_sem_give ( &ftms_sem );
-
-    return rc == -ENOTCONN ? 0 : rc;
+    status_notify ( &evt );
 }
 
 SYS_INIT ( ftms_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
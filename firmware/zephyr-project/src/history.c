@@ -0,0 +1,374 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "history.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "telemetry.h"
+
+LOG_MODULE_REGISTER ( history );
+
+static struct k_spinlock historyLock;
+static history_block_t blocks [HISTORY_BLOCKS];
+static size_t headBlock = 0;    // Block being filled
+static size_t oldestBlock = 0;
+static uint32_t nextSeq = 0;
+static history_sample_t prevSample;
+
+// One bulk read at a time, sent from the system work queue
+typedef struct
+{
+    struct bt_conn *conn;
+    uint32_t seq;     // Next sample to send
+    uint32_t reqSeq;
+    bool restart;
+    bool done;
+    history_block_t snap;
+    uint16_t snapLen;
+    uint16_t offset;
+} history_stream_t;
+
+static struct k_spinlock streamLock;
+static history_stream_t stream;
+static const struct bt_gatt_attr *dataAttr = NULL;
+
+static void sample_timer_expiry ( struct k_timer *timer );
+static void sample_work_handler ( struct k_work *work );
+static void stream_work_handler ( struct k_work *work );
+K_TIMER_DEFINE ( sample_timer, sample_timer_expiry, NULL );
+K_WORK_DEFINE ( sample_work, sample_work_handler );
+K_WORK_DELAYABLE_DEFINE ( stream_work, stream_work_handler );
+
+static size_t put_varint ( uint8_t *buf, int32_t value )
+{
+    uint32_t zz = ( ( uint32_t )value << 1 ) ^ ( uint32_t )( value >> 31 );
+    size_t len = 0;
+    do {
+        buf [len] = zz & 0x7F;
+        zz >>= 7;
+        if ( zz ) {
+            buf [len] |= 0x80;
+        }
+        len++;
+    } while ( zz );
+    return len;
+}
+
+static size_t encode_delta ( const history_sample_t *prev,
+                             const history_sample_t *cur,
+                             uint8_t *buf )
+{
+    size_t len = 1;
+    buf [0] = 0;
+    if ( cur->watts != prev->watts ) {
+        buf [0] |= HISTORY_WATTS_BIT;
+        len += put_varint ( &buf [len], cur->watts - prev->watts );
+    }
+    if ( cur->rpm != prev->rpm ) {
+        buf [0] |= HISTORY_RPM_BIT;
+        len += put_varint ( &buf [len], cur->rpm - prev->rpm );
+    }
+    if ( cur->incline != prev->incline ) {
+        buf [0] |= HISTORY_INC_BIT;
+        len += put_varint ( &buf [len], cur->incline - prev->incline );
+    }
+    if ( cur->resistance != prev->resistance ) {
+        buf [0] |= HISTORY_RES_BIT;
+        len += put_varint ( &buf [len], cur->resistance - prev->resistance );
+    }
+    return len;
+}
+
+static void start_block ( history_block_t *block,
+                          const history_sample_t *sample )
+{
+    block->hdr.seq = nextSeq;
+    block->hdr.count = 1;
+    block->hdr.len = 0;
+    block->hdr.first = *sample;
+}
+
+static void sample_work_handler ( struct k_work *work )
+{
+    bike_data_t data;
+    telemetryGetSample ( &data );
+
+    history_sample_t sample
+        = { .watts = data.watts,
+            .rpm = MIN ( data.act_rpm, UINT8_MAX ),
+            .incline = data.tgt_inc,
+            .resistance = data.disp_res };
+    uint8_t rec [HISTORY_RECORD_MAX];
+    const size_t len = encode_delta ( &prevSample, &sample, rec );
+
+    k_spinlock_key_t key = k_spin_lock ( &historyLock );
+    history_block_t *block = &blocks [headBlock];
+    if ( !nextSeq ) {
+        start_block ( block, &sample );
+    } else if ( block->hdr.len + len > sizeof ( block->data ) ) {
+        // Full, move on and drop the oldest block if the ring wrapped
+        headBlock = ( headBlock + 1 ) % HISTORY_BLOCKS;
+        if ( headBlock == oldestBlock ) {
+            oldestBlock = ( oldestBlock + 1 ) % HISTORY_BLOCKS;
+        }
+        block = &blocks [headBlock];
+        start_block ( block, &sample );
+    } else {
+        memcpy ( &block->data [block->hdr.len], rec, len );
+        block->hdr.len += len;
+        block->hdr.count++;
+    }
+    prevSample = sample;
+    nextSeq++;
+    k_spin_unlock ( &historyLock, key );
+}
+
+static void sample_timer_expiry ( struct k_timer *timer )
+{
+    k_work_submit ( &sample_work );
+}
+
+// Copies the block holding seq, returns 0 once there is nothing left
+static uint16_t load_block ( uint32_t seq, history_block_t *snap )
+{
+    uint16_t len = 0;
+    k_spinlock_key_t key = k_spin_lock ( &historyLock );
+    for ( size_t i = oldestBlock; nextSeq && seq < nextSeq;
+          i = ( i + 1 ) % HISTORY_BLOCKS ) {
+        const history_block_t *block = &blocks [i];
+        if ( seq < block->hdr.seq + block->hdr.count || i == headBlock ) {
+            len = sizeof ( block->hdr ) + block->hdr.len;
+            memcpy ( snap, block, len );
+            break;
+        }
+    }
+    k_spin_unlock ( &historyLock, key );
+    return len;
+}
+
+static void stream_stop()
+{
+    k_spinlock_key_t key = k_spin_lock ( &streamLock );
+    struct bt_conn *conn = stream.conn;
+    stream.conn = NULL;
+    k_spin_unlock ( &streamLock, key );
+    if ( conn ) {
+        bt_conn_unref ( conn );
+    }
+}
+
+// True when the read was aborted or replaced by a new request
+static bool stream_changed ( struct bt_conn *conn )
+{
+    k_spinlock_key_t key = k_spin_lock ( &streamLock );
+    bool ret = stream.conn != conn || stream.restart;
+    k_spin_unlock ( &streamLock, key );
+    return ret;
+}
+
+static void stream_work_handler ( struct k_work *work )
+{
+    k_spinlock_key_t key = k_spin_lock ( &streamLock );
+    struct bt_conn *conn = stream.conn ? bt_conn_ref ( stream.conn ) : NULL;
+    if ( stream.restart ) {
+        stream.restart = false;
+        stream.seq = stream.reqSeq;
+        stream.snapLen = 0;
+        stream.offset = 0;
+        stream.done = false;
+    }
+    k_spin_unlock ( &streamLock, key );
+    if ( !conn ) {
+        return;
+    }
+
+    const uint16_t mtu = bt_gatt_get_mtu ( conn ) - 3;
+    while ( !stream_changed ( conn ) ) {
+        if ( stream.offset == stream.snapLen ) {
+            if ( stream.done ) {
+                LOG_INF ( "History read complete" );
+                stream_stop();
+                break;
+            }
+            stream.offset = 0;
+            stream.snapLen = load_block ( stream.seq, &stream.snap );
+            if ( stream.snapLen ) {
+                stream.seq = stream.snap.hdr.seq + stream.snap.hdr.count;
+            } else {
+                memset ( &stream.snap.hdr, 0, sizeof ( stream.snap.hdr ) );
+                stream.snap.hdr.seq = stream.seq;
+                stream.snapLen = sizeof ( stream.snap.hdr );
+                stream.done = true;
+            }
+        }
+
+        const uint16_t len = MIN ( mtu, stream.snapLen - stream.offset );
+        int rc = bt_gatt_notify (
+            conn, dataAttr, ( uint8_t * )&stream.snap + stream.offset, len );
+        if ( rc == -ENOMEM ) {
+            // Out of buffers, pick up where we left off
+            k_work_reschedule ( &stream_work,
+                                K_MSEC ( HISTORY_STREAM_RETRY_MS ) );
+            break;
+        }
+        if ( rc ) {
+            LOG_WRN ( "History notify failed: %d", rc );
+            stream_stop();
+            break;
+        }
+        stream.offset += len;
+    }
+    if ( stream_changed ( conn ) ) {
+        k_work_reschedule ( &stream_work, K_NO_WAIT );
+    }
+    bt_conn_unref ( conn );
+}
+
+static void history_data_ccc_changed ( const struct bt_gatt_attr *attr,
+                                       uint16_t value )
+{
+    LOG_INF ( "History notifications %s",
+              value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled" );
+}
+
+static ssize_t read_info ( struct bt_conn *conn,
+                           const struct bt_gatt_attr *attr,
+                           void *buf,
+                           uint16_t len,
+                           uint16_t offset )
+{
+    history_info_t info = { .period_ms = HISTORY_PERIOD_MS };
+    k_spinlock_key_t key = k_spin_lock ( &historyLock );
+    info.firstSeq = blocks [oldestBlock].hdr.seq;
+    info.nextSeq = nextSeq;
+    k_spin_unlock ( &historyLock, key );
+
+    return bt_gatt_attr_read (
+        conn, attr, buf, len, offset, &info, sizeof ( info ) );
+}
+
+static ssize_t write_control ( struct bt_conn *conn,
+                               const struct bt_gatt_attr *attr,
+                               const void *buf,
+                               uint16_t len,
+                               uint16_t offset,
+                               uint8_t flags )
+{
+    if ( offset ) {
+        return BT_GATT_ERR ( BT_ATT_ERR_INVALID_OFFSET );
+    }
+    if ( !len ) {
+        return BT_GATT_ERR ( BT_ATT_ERR_INVALID_ATTRIBUTE_LEN );
+    }
+
+    const uint8_t *req = buf;
+    k_spinlock_key_t key;
+    switch ( req [0] ) {
+        case HISTORY_OP_READ:
+            if ( len != sizeof ( history_req_t ) ) {
+                return BT_GATT_ERR ( BT_ATT_ERR_INVALID_ATTRIBUTE_LEN );
+            }
+            if ( !bt_gatt_is_subscribed (
+                     conn, dataAttr, BT_GATT_CCC_NOTIFY ) ) {
+                return BT_GATT_ERR ( BT_ATT_ERR_CCC_IMPROPER_CONF );
+            }
+            key = k_spin_lock ( &streamLock );
+            if ( stream.conn && stream.conn != conn ) {
+                k_spin_unlock ( &streamLock, key );
+                return BT_GATT_ERR ( BT_ATT_ERR_PROCEDURE_IN_PROGRESS );
+            }
+            if ( !stream.conn ) {
+                stream.conn = bt_conn_ref ( conn );
+            }
+            stream.reqSeq = sys_get_le32 ( &req [1] );
+            stream.restart = true;
+            k_spin_unlock ( &streamLock, key );
+            LOG_INF ( "History read from %u", stream.reqSeq );
+            k_work_reschedule ( &stream_work, K_NO_WAIT );
+            break;
+        case HISTORY_OP_ABORT:
+            if ( stream.conn == conn ) {
+                stream_stop();
+            }
+            break;
+        default:
+            return BT_GATT_ERR ( BT_ATT_ERR_NOT_SUPPORTED );
+    }
+
+    return len;
+}
+
+// Create service
+BT_GATT_SERVICE_DEFINE (
+    history_svc,
+    BT_GATT_PRIMARY_SERVICE ( BT_UUID_HISTORY ),
+    BT_GATT_CHARACTERISTIC ( BLE_UUID_HISTORY_CONTROL_CHAR,
+                             BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                             BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                             read_info,
+                             write_control,
+                             NULL ),
+    BT_GATT_CHARACTERISTIC ( BLE_UUID_HISTORY_DATA_CHAR,
+                             BT_GATT_CHRC_NOTIFY,
+                             BT_GATT_PERM_NONE,
+                             NULL,
+                             NULL,
+                             NULL ),
+    BT_GATT_CCC ( history_data_ccc_changed,
+                  ( BT_GATT_PERM_READ | BT_GATT_PERM_WRITE ) ), );
+
+static void history_disconnected ( struct bt_conn *conn, uint8_t reason )
+{
+    ARG_UNUSED ( reason );
+    if ( stream.conn == conn ) {
+        stream_stop();
+    }
+}
+
+BT_CONN_CB_DEFINE ( history_conn_callbacks )
+    = { .disconnected = history_disconnected };
+
+static int history_init ( const struct device *dev )
+{
+    ARG_UNUSED ( dev );
+
+    dataAttr = bt_gatt_find_by_uuid (
+        history_svc.attrs, history_svc.attr_count, BLE_UUID_HISTORY_DATA_CHAR );
+    if ( !dataAttr ) {
+        LOG_ERR ( "History data characteristic not found!" );
+        return -ENOENT;
+    }
+
+    k_timer_start ( &sample_timer,
+                    K_MSEC ( HISTORY_PERIOD_MS ),
+                    K_MSEC ( HISTORY_PERIOD_MS ) );
+
+    LOG_INF ( "History initialized" );
+
+    return 0;
+}
+
+SYS_INIT ( history_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
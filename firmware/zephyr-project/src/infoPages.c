@@ -0,0 +1,347 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "infoPages.h"
+
+#include <string.h>
+#include <lvgl.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include "bikeControl.h"
+#include "bikeMgmt.h"
+#include "display.h"
+#include "numFmt.h"
+#include "pages.h"
+
+LOG_MODULE_REGISTER ( info_pages );
+
+typedef struct
+{
+    uint32_t moving_ms;
+    uint64_t energy_mJ;  // watts * ms
+    uint64_t revs_ms;    // rpm * ms
+    uint16_t maxWatts;
+    uint32_t last_ms;
+} summary_t;
+
+static summary_t summary = {};
+static lv_style_t rowStyle;
+static lv_obj_t *summaryValues;
+static lv_obj_t *diagValues;
+static lv_obj_t *settingsValues;
+static char summaryText [48];
+static char diagText [96];
+static char settingsText [16];
+static uint32_t lastRefresh_ms = 0;
+
+// Text helpers, output is truncated at end
+static void put_str ( char **pos, const char *end, const char *str )
+{
+    while ( *str && *pos < end - 1 ) {
+        *( *pos )++ = *str++;
+    }
+    **pos = '\0';
+}
+
+static void put_uint ( char **pos, const char *end, uint32_t value )
+{
+    *pos += numFmtUint ( *pos, end - *pos, value );
+}
+
+static void put_int ( char **pos, const char *end, int32_t value )
+{
+    *pos += numFmtFixed ( *pos, end - *pos, value, 0 );
+}
+
+// Only invalidates the label when the text differs
+static void set_values ( lv_obj_t *label, char *text, const char *next )
+{
+    if ( strcmp ( text, next ) ) {
+        strcpy ( text, next );
+        lv_label_set_text_static ( label, text );
+    }
+}
+
+static bool refresh_due()
+{
+    const uint32_t now_ms = k_uptime_get_32();
+    if ( now_ms - lastRefresh_ms < INFO_REFRESH_MS ) {
+        return false;
+    }
+    lastRefresh_ms = now_ms;
+    return true;
+}
+
+// Names on the left, values right aligned in a second label
+static lv_obj_t *create_rows ( lv_obj_t *scr,
+                               const char *names,
+                               lv_coord_t lineSpace )
+{
+    static bool styled = false;
+    if ( !styled ) {
+        lv_style_init ( &rowStyle );
+        lv_style_set_text_font ( &rowStyle, &lv_font_montserrat_24 );
+        styled = true;
+    }
+
+    lv_obj_t *nameLabel = lv_label_create ( scr );
+    lv_obj_add_style ( nameLabel, &rowStyle, 0 );
+    lv_label_set_text_static ( nameLabel, names );
+    lv_obj_set_style_text_line_space ( nameLabel, lineSpace, 0 );
+    lv_obj_align ( nameLabel, LV_ALIGN_TOP_LEFT, 12, INFO_ROWS_Y );
+
+    lv_obj_t *values = lv_label_create ( scr );
+    lv_obj_add_style ( values, &rowStyle, 0 );
+    lv_obj_set_style_text_align ( values, LV_TEXT_ALIGN_RIGHT, 0 );
+    lv_obj_set_style_text_line_space ( values, lineSpace, 0 );
+    lv_obj_align ( values, LV_ALIGN_TOP_RIGHT, -12, INFO_ROWS_Y );
+    lv_label_set_text_static ( values, "" );
+    lastRefresh_ms = k_uptime_get_32() - INFO_REFRESH_MS;
+    return values;
+}
+
+void summarySample ( bike_data_t data )
+{
+    const uint32_t now_ms = k_uptime_get_32();
+    const uint32_t dt_ms = now_ms - summary.last_ms;
+    summary.last_ms = now_ms;
+    if ( !data.act_rpm || dt_ms > INFO_SAMPLE_MAX_MS ) {
+        return;
+    }
+    summary.moving_ms += dt_ms;
+    summary.energy_mJ += ( uint64_t )data.watts * dt_ms;
+    summary.revs_ms += ( uint64_t )data.act_rpm * dt_ms;
+    summary.maxWatts = MAX ( summary.maxWatts, data.watts );
+}
+
+void summaryReset()
+{
+    const uint32_t last_ms = summary.last_ms;
+    memset ( &summary, 0, sizeof ( summary ) );
+    summary.last_ms = last_ms;
+}
+
+static void summary_create ( lv_obj_t *scr )
+{
+    summaryValues = create_rows (
+        scr, "Moving\nAvg watts\nMax watts\nAvg rpm\nEnergy kJ", 0 );
+    summaryText [0] = '\0';
+}
+
+static void summary_update ( const bike_data_t *data )
+{
+    if ( !refresh_due() ) {
+        return;
+    }
+
+    const uint32_t secs = summary.moving_ms / 1000U;
+    const uint32_t ms = MAX ( summary.moving_ms, 1U );
+    char text [sizeof ( summaryText )];
+    char *pos = text;
+    const char *end = text + sizeof ( text );
+    char hms [9];
+    numFmtPad ( &hms [0], 2, secs / 3600U );
+    hms [2] = ':';
+    numFmtPad ( &hms [3], 2, secs / 60U % 60U );
+    hms [5] = ':';
+    numFmtPad ( &hms [6], 2, secs % 60U );
+    hms [8] = '\0';
+
+    put_str ( &pos, end, hms );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, summary.energy_mJ / ms );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, summary.maxWatts );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, summary.revs_ms / ms );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, summary.energy_mJ / 1000000U );
+    set_values ( summaryValues, summaryText, text );
+}
+
+const page_desc_t summaryPage = { .title = "Summary",
+                                  .create = summary_create,
+                                  .update = summary_update,
+                                  .resident = false };
+
+static void diag_create ( lv_obj_t *scr )
+{
+    diagValues = create_rows ( scr,
+                               "Rpm\nIncline raw\nIncline set\n"
+                               "Resistance raw\nWatts\nERG watts\n"
+                               "Incline rx/tx\nRes rx/tx\nDisplay px/s",
+                               0 );
+    diagText [0] = '\0';
+}
+
+static void diag_update ( const bike_data_t *data )
+{
+    if ( !refresh_due() ) {
+        return;
+    }
+
+    const bike_diag_t diag = getBikeDiag();
+    const display_stats_t disp = getDisplayStats();
+    char text [sizeof ( diagText )];
+    char *pos = text;
+    const char *end = text + sizeof ( text );
+
+    put_uint ( &pos, end, diag.act_rpm );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, diag.act_inc );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, diag.set_inc );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, diag.set_res );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, diag.watts );
+    put_str ( &pos, end, "\n" );
+    if ( diag.ergWatts == TGT_PWR_INVALID ) {
+        put_str ( &pos, end, "Off" );
+    } else {
+        put_uint ( &pos, end, diag.ergWatts );
+    }
+    for ( int i = 0; i < TGT_ACTUATOR_CNT; i++ ) {
+        put_str ( &pos, end, "\n" );
+        put_uint ( &pos, end, diag.stats [i].received );
+        put_str ( &pos, end, "/" );
+        put_uint ( &pos, end, diag.stats [i].issued );
+    }
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, disp.px_per_s );
+    set_values ( diagValues, diagText, text );
+}
+
+const page_desc_t diagPage = { .title = "Diagnostics",
+                               .create = diag_create,
+                               .update = diag_update,
+                               .resident = false };
+
+static void refresh_settings()
+{
+    const bike_params_t params = getBikeParams();
+    char text [sizeof ( settingsText )];
+    char *pos = text;
+    const char *end = text + sizeof ( text );
+
+    put_int ( &pos, end, params.wattsOffset );
+    put_str ( &pos, end, "\n" );
+    put_uint ( &pos, end, params.wattsScale_pct );
+    set_values ( settingsValues, settingsText, text );
+}
+
+// Out of range steps are rejected by setBikeParams()
+static void adjust_params ( const bike_params_t *params )
+{
+    if ( !setBikeParams ( params ) ) {
+        refresh_settings();
+    }
+}
+
+static void offset_cb ( lv_event_t *e )
+{
+    bike_params_t params = getBikeParams();
+    params.wattsOffset += ( intptr_t )lv_event_get_user_data ( e );
+    adjust_params ( &params );
+}
+
+static void scale_cb ( lv_event_t *e )
+{
+    bike_params_t params = getBikeParams();
+    params.wattsScale_pct += ( intptr_t )lv_event_get_user_data ( e );
+    adjust_params ( &params );
+}
+
+// Flash writes can stall for an erase, keep them off the display thread
+static void save_work_handler ( struct k_work *work )
+{
+    const bike_params_t params = getBikeParams();
+    int rc = settings_save_one (
+        BIKE_MGMT_SETTINGS_KEY, &params, sizeof ( params ) );
+    if ( rc ) {
+        LOG_ERR ( "Failed to save parameters: %d", rc );
+    }
+}
+
+K_WORK_DEFINE ( save_work, save_work_handler );
+
+static void save_cb ( lv_event_t *e )
+{
+    k_work_submit ( &save_work );
+}
+
+static void add_button ( lv_obj_t *scr,
+                         const char *text,
+                         lv_coord_t x,
+                         lv_coord_t y,
+                         lv_event_cb_t cb,
+                         int step )
+{
+    lv_obj_t *btn = lv_btn_create ( scr );
+    lv_obj_set_size ( btn, PAGE_NAV_W, PAGE_NAV_H );
+    lv_obj_align ( btn, LV_ALIGN_TOP_LEFT, x, y );
+    lv_obj_add_event_cb (
+        btn, cb, LV_EVENT_CLICKED, ( void * )( intptr_t )step );
+
+    lv_obj_t *label = lv_label_create ( btn );
+    lv_obj_add_style ( label, &rowStyle, 0 );
+    lv_label_set_text_static ( label, text );
+    lv_obj_center ( label );
+}
+
+static void settings_create ( lv_obj_t *scr )
+{
+    // Rows spaced out to line up with their - and + buttons
+    const lv_coord_t lineSpace
+        = SETTINGS_ROW_H - lv_font_get_line_height ( &lv_font_montserrat_24 );
+    settingsValues
+        = create_rows ( scr, "Watts offset\nWatts scale %", lineSpace );
+    lv_obj_align ( settingsValues, LV_ALIGN_TOP_RIGHT, -112, INFO_ROWS_Y );
+    settingsText [0] = '\0';
+
+    const lv_coord_t offsetY = INFO_ROWS_Y;
+    const lv_coord_t scaleY = INFO_ROWS_Y + SETTINGS_ROW_H;
+    add_button ( scr, "-", 216, offsetY, offset_cb, -SETTINGS_OFFSET_STEP );
+    add_button ( scr, "+", 268, offsetY, offset_cb, SETTINGS_OFFSET_STEP );
+    add_button ( scr, "-", 216, scaleY, scale_cb, -SETTINGS_SCALE_STEP );
+    add_button ( scr, "+", 268, scaleY, scale_cb, SETTINGS_SCALE_STEP );
+
+    lv_obj_t *save = lv_btn_create ( scr );
+    lv_obj_add_event_cb ( save, save_cb, LV_EVENT_CLICKED, NULL );
+    lv_obj_align ( save, LV_ALIGN_TOP_MID, 0, 440 );
+    lv_obj_set_size ( save, 300, 38 );
+    lv_obj_t *label = lv_label_create ( save );
+    lv_obj_add_style ( label, &rowStyle, 0 );
+    lv_label_set_text_static ( label, "Save" );
+    lv_obj_center ( label );
+}
+
+static void settings_update ( const bike_data_t *data )
+{
+    // Also picks up changes made over SMP
+    if ( refresh_due() ) {
+        refresh_settings();
+    }
+}
+
+const page_desc_t settingsPage = { .title = "Settings",
+                                   .create = settings_create,
+                                   .update = settings_update,
+                                   .resident = false };
@@ -0,0 +1,94 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logRing.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log_backend.h>
+#include <zephyr/logging/log_msg.h>
+#include <zephyr/logging/log_output.h>
+#include <zephyr/logging/log_output_dict.h>
+#include <zephyr/sys/ring_buffer.h>
+
+static struct k_spinlock ringLock;
+static uint32_t ringDropped = 0;  // Messages that didn't fit
+RING_BUF_DECLARE ( log_ring, LOG_RING_SIZE );
+
+static int char_out ( uint8_t *data, size_t length, void *ctx )
+{
+    ARG_UNUSED ( ctx );
+
+    k_spinlock_key_t key = k_spin_lock ( &ringLock );
+    ring_buf_put ( &log_ring, data, length );
+    k_spin_unlock ( &ringLock, key );
+    return length;
+}
+
+static uint8_t outBuf [LOG_RING_OUT_SIZE];
+LOG_OUTPUT_DEFINE ( log_output_ring, char_out, outBuf, sizeof ( outBuf ) );
+
+// Messages are added whole or not at all, the stream never desyncs
+static bool reserve ( uint32_t len )
+{
+    k_spinlock_key_t key = k_spin_lock ( &ringLock );
+    bool ret = ring_buf_space_get ( &log_ring ) >= len;
+    if ( !ret ) {
+        ringDropped++;
+    }
+    k_spin_unlock ( &ringLock, key );
+    return ret;
+}
+
+static void process ( const struct log_backend *const backend,
+                      union log_msg_generic *msg )
+{
+    const uint32_t len
+        = log_msg_generic_get_wlen ( ( union mpsc_pbuf_generic * )msg )
+              * sizeof ( uint32_t )
+          + LOG_RING_HDR_MAX;
+    if ( reserve ( len ) ) {
+        log_dict_output_msg_process ( &log_output_ring, &msg->log, 0 );
+    }
+}
+
+static void dropped ( const struct log_backend *const backend, uint32_t cnt )
+{
+    if ( reserve ( LOG_RING_HDR_MAX ) ) {
+        log_dict_output_dropped_process ( &log_output_ring, cnt );
+    }
+}
+
+static void panic ( const struct log_backend *const backend )
+{
+    log_output_flush ( &log_output_ring );
+}
+
+size_t logRingRead ( uint8_t *buf, size_t len, uint32_t *dropped )
+{
+    k_spinlock_key_t key = k_spin_lock ( &ringLock );
+    size_t ret = ring_buf_get ( &log_ring, buf, len );
+    *dropped = ringDropped;
+    ringDropped = 0;
+    k_spin_unlock ( &ringLock, key );
+    return ret;
+}
+
+static const struct log_backend_api log_backend_ring_api
+    = { .process = process, .dropped = dropped, .panic = panic };
+
+LOG_BACKEND_DEFINE ( log_backend_ring, log_backend_ring_api, true );
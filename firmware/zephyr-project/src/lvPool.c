@@ -0,0 +1,196 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lvPool.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER ( lv_pool );
+
+// LVGL's own allocator, reached through the linker's --wrap
+void *__real_lvgl_malloc ( size_t size );
+void __real_lvgl_free ( void *ptr );
+
+#define POOL_BYTES                               \
+    ( 16 * CONFIG_UBIKE_LV_POOL_16_BLOCKS         \
+      + 32 * CONFIG_UBIKE_LV_POOL_32_BLOCKS       \
+      + 64 * CONFIG_UBIKE_LV_POOL_64_BLOCKS       \
+      + 128 * CONFIG_UBIKE_LV_POOL_128_BLOCKS     \
+      + 256 * CONFIG_UBIKE_LV_POOL_256_BLOCKS )
+#define HEAP_BYTES \
+    ( CONFIG_LV_Z_MEM_POOL_MAX_SIZE * CONFIG_LV_Z_MEM_POOL_NUMBER_BLOCKS )
+
+// Every pool block comes out of LVGL's heap, not extra RAM
+BUILD_ASSERT ( POOL_BYTES + HEAP_BYTES <= CONFIG_UBIKE_LV_POOL_RAM,
+               "LVGL pools and heap exceed CONFIG_UBIKE_LV_POOL_RAM" );
+
+K_MEM_SLAB_DEFINE ( lv_pool_16, 16, CONFIG_UBIKE_LV_POOL_16_BLOCKS, 8 );
+K_MEM_SLAB_DEFINE ( lv_pool_32, 32, CONFIG_UBIKE_LV_POOL_32_BLOCKS, 8 );
+K_MEM_SLAB_DEFINE ( lv_pool_64, 64, CONFIG_UBIKE_LV_POOL_64_BLOCKS, 8 );
+K_MEM_SLAB_DEFINE ( lv_pool_128, 128, CONFIG_UBIKE_LV_POOL_128_BLOCKS, 8 );
+K_MEM_SLAB_DEFINE ( lv_pool_256, 256, CONFIG_UBIKE_LV_POOL_256_BLOCKS, 8 );
+
+static struct k_mem_slab *const slabs [LV_POOL_CLASS_CNT]
+    = { &lv_pool_16, &lv_pool_32, &lv_pool_64, &lv_pool_128, &lv_pool_256 };
+static struct k_spinlock poolLock;
+static lv_pool_stats_t stats = {
+    .classes = { { .size = 16, .blocks = CONFIG_UBIKE_LV_POOL_16_BLOCKS },
+                 { .size = 32, .blocks = CONFIG_UBIKE_LV_POOL_32_BLOCKS },
+                 { .size = 64, .blocks = CONFIG_UBIKE_LV_POOL_64_BLOCKS },
+                 { .size = 128, .blocks = CONFIG_UBIKE_LV_POOL_128_BLOCKS },
+                 { .size = 256, .blocks = CONFIG_UBIKE_LV_POOL_256_BLOCKS } }
+};
+
+// Call with poolLock held
+static void add_used ( int32_t bytes )
+{
+    stats.used += bytes;
+    stats.peak = MAX ( stats.peak, stats.used );
+}
+
+static int find_class ( const void *ptr )
+{
+    for ( int i = 0; i < LV_POOL_CLASS_CNT; i++ ) {
+        const lv_pool_class_t *cls = &stats.classes [i];
+        const char *start = slabs [i]->buffer;
+        const char *end = start + cls->size * cls->blocks;
+        if ( ( const char * )ptr >= start && ( const char * )ptr < end ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void *heap_alloc ( size_t size )
+{
+    uint8_t *blk = __real_lvgl_malloc ( size + LV_POOL_HDR_SIZE );
+    k_spinlock_key_t key = k_spin_lock ( &poolLock );
+    if ( !blk ) {
+        stats.fails++;
+        k_spin_unlock ( &poolLock, key );
+        return NULL;
+    }
+    stats.heapUsed += size;
+    stats.heapPeak = MAX ( stats.heapPeak, stats.heapUsed );
+    add_used ( size );
+    k_spin_unlock ( &poolLock, key );
+
+    *( size_t * )blk = size;
+    return blk + LV_POOL_HDR_SIZE;
+}
+
+static size_t heap_size ( const void *ptr )
+{
+    return *( const size_t * )( ( const uint8_t * )ptr - LV_POOL_HDR_SIZE );
+}
+
+// Smallest class with a free block, full classes spill to the next one
+void *__wrap_lvgl_malloc ( size_t size )
+{
+    if ( !size ) {
+        return NULL;
+    }
+
+    for ( int i = 0; i < LV_POOL_CLASS_CNT; i++ ) {
+        lv_pool_class_t *cls = &stats.classes [i];
+        if ( size > cls->size ) {
+            continue;
+        }
+
+        void *blk;
+        const bool ok = !k_mem_slab_alloc ( slabs [i], &blk, K_NO_WAIT );
+        k_spinlock_key_t key = k_spin_lock ( &poolLock );
+        if ( ok ) {
+            cls->used++;
+            cls->peak = MAX ( cls->peak, cls->used );
+            add_used ( cls->size );
+        } else {
+            cls->spills++;
+        }
+        k_spin_unlock ( &poolLock, key );
+        if ( ok ) {
+            return blk;
+        }
+    }
+    return heap_alloc ( size );
+}
+
+void __wrap_lvgl_free ( void *ptr )
+{
+    if ( !ptr ) {
+        return;
+    }
+
+    const int i = find_class ( ptr );
+    k_spinlock_key_t key = k_spin_lock ( &poolLock );
+    if ( i >= 0 ) {
+        stats.classes [i].used--;
+        add_used ( -( int32_t )stats.classes [i].size );
+    } else {
+        stats.heapUsed -= heap_size ( ptr );
+        add_used ( -( int32_t )heap_size ( ptr ) );
+    }
+    k_spin_unlock ( &poolLock, key );
+
+    if ( i >= 0 ) {
+        k_mem_slab_free ( slabs [i], &ptr );
+    } else {
+        __real_lvgl_free ( ( uint8_t * )ptr - LV_POOL_HDR_SIZE );
+    }
+}
+
+// Style and event arrays grow one entry at a time, most stay in place
+void *__wrap_lvgl_realloc ( void *ptr, size_t size )
+{
+    if ( !ptr ) {
+        return __wrap_lvgl_malloc ( size );
+    }
+    if ( !size ) {
+        __wrap_lvgl_free ( ptr );
+        return NULL;
+    }
+
+    const int i = find_class ( ptr );
+    size_t oldSize;
+    if ( i >= 0 ) {
+        oldSize = stats.classes [i].size;
+        if ( size <= oldSize ) {
+            return ptr;
+        }
+    } else {
+        oldSize = heap_size ( ptr );
+    }
+
+    void *next = __wrap_lvgl_malloc ( size );
+    if ( !next ) {
+        return NULL;
+    }
+    memcpy ( next, ptr, MIN ( oldSize, size ) );
+    __wrap_lvgl_free ( ptr );
+    return next;
+}
+
+lv_pool_stats_t getLvPoolStats()
+{
+    k_spinlock_key_t key = k_spin_lock ( &poolLock );
+    const lv_pool_stats_t copy = stats;
+    k_spin_unlock ( &poolLock, key );
+    return copy;
+}
@@ -22,6 +22,7 @@
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/hci.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/drivers/counter.h>
 #include <zephyr/drivers/gpio.h>
@@ -30,25 +31,26 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/mgmt/mcumgr/transport/smp_bt.h>
 #include <zephyr/random/rand32.h>
+#include <zephyr/settings/settings.h>
 #include <zephyr/types.h>
 
+#include "advertise.h"
 #include "asciiModbus.h"
 #include "bikeControl.h"
+#include "bikeMgmt.h"
+#include "broadcast.h"
+#include "connMgr.h"
 #include "cps.h"
 #include "cscs.h"
 #include "display.h"
-// #include "fec.h"
+#include "fec.h"
 #include "ftms.h"
+#include "telemetry.h"
+#include "trace.h"
 #include "version.h"
 
 LOG_MODULE_REGISTER ( app );
 
-#define DEVICE_NAME CONFIG_BT_DEVICE_NAME
-#define DEVICE_NAME_LEN ( sizeof ( DEVICE_NAME ) - 1 )
-#define BT_DEVICE_CYCLING_APPEARANCE 0x012
-
-#define TGT_CYCLE_MS 500
-
 #define LED0_NODE DT_ALIAS ( led0 )
 #define RS485DE_NODE DT_ALIAS ( rs485de )
 #define CPT_RST_NODE DT_ALIAS ( cptrst )
@@ -67,67 +69,22 @@ LOG_MODULE_REGISTER ( app );
 #define TX_TIMEOUT_US 2000
 #define SEM_TIMEOUT K_MSEC ( 50 )
 
-static const struct bt_data ad []
-    = { BT_DATA_BYTES ( BT_DATA_GAP_APPEARANCE,
-                        ( BT_DEVICE_CYCLING_APPEARANCE >> 0 ) & 0xff,
-                        ( BT_DEVICE_CYCLING_APPEARANCE >> 8 ) & 0xff ),
-        BT_DATA_BYTES ( BT_DATA_FLAGS,
-                        ( BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR ) ),
-        BT_DATA_BYTES ( BT_DATA_UUID16_ALL,
-                        BT_UUID_16_ENCODE ( BT_UUID_CPS_VAL ),
-                        BT_UUID_16_ENCODE ( BT_UUID_CSC_VAL ),
-                        BT_UUID_16_ENCODE ( BT_UUID_FTMS_VAL ) ),
-        BT_DATA ( BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN ) };
-
-static const struct bt_data sd [] = {
-    BT_DATA_BYTES ( BT_DATA_UUID128_ALL,
-                    0x84,
-                    0xaa,
-                    0x60,
-                    0x74,
-                    0x52,
-                    0x8a,
-                    0x8b,
-                    0x86,
-                    0xd3,
-                    0x4c,
-                    0xb7,
-                    0x1d,
-                    0x1d,
-                    0xdc,
-                    0x53,
-                    0x8d ),
-};
-
-static void adv_start ( void )
-{
-    int err;
-
-    err = bt_le_adv_start ( BT_LE_ADV_CONN,
-                            ad,
-                            ARRAY_SIZE ( ad ),
-                            sd,
-                            ARRAY_SIZE ( sd ) );
-    if ( err ) {
-        LOG_ERR ( "Advertising failed to start (err %d)", err );
-        return;
-    }
-
-    LOG_INF ( "Advertising successfully started" );
-}
-
 static void connected ( struct bt_conn *conn, uint8_t err )
 {
-    if ( err ) {
+    if ( err == BT_HCI_ERR_ADV_TIMEOUT ) {
+        return;  // Directed advertising, see advertise.c
+    } else if ( err ) {
         LOG_ERR ( "Connection failed (err 0x%02x)", err );
     } else {
         LOG_INF ( "Connected" );
+        connMgrConnected ( conn );
     }
 }
 
 static void disconnected ( struct bt_conn *conn, uint8_t reason )
 {
     LOG_INF ( "Disconnected (reason 0x%02x)", reason );
+    connMgrDisconnected ( conn );
 }
 
 BT_CONN_CB_DEFINE ( conn_callbacks )
@@ -250,6 +207,7 @@ static void incPressed ( const struct device *dev,
             = evaluateButton ( gpio_pin_get ( addInc.port, addInc.pin ),
                                gpio_pin_get ( subInc.port, subInc.pin ) );
         adjustIncline ( adj );
+        displayWake();
     }
 }
 
@@ -269,6 +227,7 @@ static void resPressed ( const struct device *dev,
             = evaluateButton ( gpio_pin_get ( addRes.port, addRes.pin ),
                                gpio_pin_get ( subRes.port, subRes.pin ) );
         adjustResistance ( adj );
+        displayWake();
     }
 }
 
@@ -293,6 +252,7 @@ static void add_rx_bytes ( char *buff, size_t offset, size_t len )
                 int res = new_msg ( start, pos - ( start - msg ) );
                 if ( res ) {
                     LOG_ERR ( "Failed to process new message: %d", res );
+                    traceRecord ( TRACE_BUS_ERR, -res, 0, 0, 0 );
                 }
                 k_sem_give ( &rs485_sem );
                 k_condvar_signal ( &rxDoneVar );
@@ -378,7 +338,8 @@ void main ( void )
     LOG_INF ( "Registering callbacks..." );
     setSendMsgCb ( send_cmd );
     ftmsSetTargetsCb ( updateBikeTgts );
-    // fecSetTargetsCb ( updateBikeTgts );
+    ftmsSetActivityCb ( connMgrControlActivity );
+    fecSetTargetsCb ( updateBikeTgts );
 
     LOG_INF ( "Configuring GPIO..." );
     int ret = 0;
@@ -522,8 +483,17 @@ void main ( void )
         LOG_ERR ( "Bluetooth init failed (err %d)", ret );
         return;
     }
+    ret = settings_load();
+    if ( ret ) {
+        LOG_ERR ( "Settings load failed (err %d)", ret );
+    }
     LOG_INF ( "Starting advertising..." );
-    adv_start();
+    advertiseStart();
+#if defined( CONFIG_UBIKE_BROADCAST )
+    if ( broadcastStart() ) {
+        LOG_ERR ( "Broadcast failed to start!" );
+    }
+#endif
 
     LOG_INF ( "Starting counter..." );
     if ( !device_is_ready ( rtc2_dev ) ) {
@@ -567,19 +537,27 @@ void main ( void )
 #endif
 
         // Update bluetooth services
-        bt_cscs_bike_notify ( bikeData );
-        bt_cps_notify ( bikeData );
-        bt_ftms_bike_notify ( bikeData );
-        // bt_fec_update ( bikeData );
-        bt_ftms_status_notify();
+        telemetryPublish ( bikeData );
+        bt_ftms_status_update ( bikeData );
 
         // Update display
         updateDisplay ( bikeData );
 
         // Sleep to hit cycle target
         exec_ms = k_uptime_get_32() - start_ms;
-        if ( exec_ms < TGT_CYCLE_MS ) {
-            k_msleep ( TGT_CYCLE_MS - exec_ms );
+        bikeMgmtLoopTime ( exec_ms );
+        const uint32_t cycle_ms = getBikeParams().poll_ms;
+        traceRecord ( TRACE_LOOP, exec_ms, cycle_ms, 0, 0 );
+
+        // Rider input ends the wait early so its write isn't held a cycle
+        while ( exec_ms < cycle_ms
+                && waitRiderInput ( cycle_ms - exec_ms ) ) {
+            updateRiderTgts();
+            const bike_data_t tgts = getBikeData();
+            bikeData.tgt_inc = tgts.tgt_inc;
+            bikeData.disp_res = tgts.disp_res;
+            updateDisplay ( bikeData );
+            exec_ms = k_uptime_get_32() - start_ms;
         }
     }
 }
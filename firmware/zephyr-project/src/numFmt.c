@@ -0,0 +1,118 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "numFmt.h"
+
+static const uint32_t pow10 [NUM_FMT_MAX_DIGITS] = { 1U,
+                                                     10U,
+                                                     100U,
+                                                     1000U,
+                                                     10000U,
+                                                     100000U,
+                                                     1000000U,
+                                                     10000000U,
+                                                     100000000U,
+                                                     1000000000U };
+
+// Largest value that fits in width digits
+static uint32_t max_value ( size_t width )
+{
+    return width < NUM_FMT_MAX_DIGITS ? pow10 [width] - 1 : UINT32_MAX;
+}
+
+// Exactly width digits, zero padded, no terminator
+void numFmtPad ( char *buf, uint8_t width, uint32_t value )
+{
+    value = MIN ( value, max_value ( width ) );
+    for ( int i = width - 1; i >= 0; i-- ) {
+        buf [i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+size_t numFmtUint ( char *buf, size_t size, uint32_t value )
+{
+    if ( size < 2 ) {
+        if ( size ) {
+            buf [0] = '\0';
+        }
+        return 0;
+    }
+
+    const size_t width = MIN ( size - 1, NUM_FMT_MAX_DIGITS );
+    value = MIN ( value, max_value ( width ) );
+    size_t len = 1;
+    while ( len < width && value >= pow10 [len] ) {
+        len++;
+    }
+    numFmtPad ( buf, len, value );
+    buf [len] = '\0';
+    return len;
+}
+
+// Value is scaled by 10^decimals, e.g. -105 with 1 decimal is "-10.5"
+size_t numFmtFixed ( char *buf, size_t size, int32_t value, uint8_t decimals )
+{
+    size_t len = 0;
+    const uint32_t mag = value < 0 ? -( uint32_t )value : ( uint32_t )value;
+    if ( value < 0 && size > 1 ) {
+        buf [len++] = '-';
+    }
+    if ( !decimals ) {
+        return len + numFmtUint ( buf + len, size - len, mag );
+    }
+
+    // Room for at least "0.x"
+    decimals = MIN ( decimals, NUM_FMT_MAX_DIGITS - 1 );
+    if ( size < len + decimals + 3 ) {
+        buf [0] = '\0';
+        return 0;
+    }
+    const size_t intWidth
+        = MIN ( size - len - decimals - 2, NUM_FMT_MAX_DIGITS );
+    uint32_t whole = mag / pow10 [decimals];
+    uint32_t frac = mag % pow10 [decimals];
+    if ( whole > max_value ( intWidth ) ) {
+        whole = max_value ( intWidth );
+        frac = pow10 [decimals] - 1;
+    }
+
+    len += numFmtUint ( buf + len, intWidth + 1, whole );
+    buf [len++] = '.';
+    numFmtPad ( buf + len, decimals, frac );
+    len += decimals;
+    buf [len] = '\0';
+    return len;
+}
+
+// Bike incline counts are 0.5% steps from -10%, e.g. 21 is "0.5%"
+size_t numFmtIncline ( char *buf, size_t size, uint16_t counts )
+{
+    if ( size < 2 ) {
+        if ( size ) {
+            buf [0] = '\0';
+        }
+        return 0;
+    }
+
+    const int32_t tenths = ( ( int32_t )counts - 20 ) * 5;
+    size_t len = numFmtFixed ( buf, size - 1, tenths, 1 );
+    buf [len++] = '%';
+    buf [len] = '\0';
+    return len;
+}
@@ -0,0 +1,129 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "numLabel.h"
+
+#include <string.h>
+
+static bool is_digit ( char c )
+{
+    return c >= '0' && c <= '9';
+}
+
+static lv_coord_t cell_width ( const num_label_t *label, char c )
+{
+    if ( is_digit ( c ) ) {
+        return label->digitW;
+    }
+    const lv_font_t *font = lv_obj_get_style_text_font ( label->obj, 0 );
+    return lv_font_get_glyph_width ( font, c, 0 );
+}
+
+static lv_coord_t text_width ( const num_label_t *label, const char *text )
+{
+    lv_coord_t w = 0;
+    for ( ; *text; text++ ) {
+        w += cell_width ( label, *text );
+    }
+    return w;
+}
+
+// Text is centred in the object, returns the absolute x of the first cell
+static lv_coord_t text_start ( const num_label_t *label, const char *text )
+{
+    return label->obj->coords.x1
+           + ( lv_obj_get_width ( label->obj ) - text_width ( label, text ) )
+                 / 2;
+}
+
+static void draw_cb ( lv_event_t *e )
+{
+    num_label_t *label = lv_event_get_user_data ( e );
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx ( e );
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init ( &dsc );
+    lv_obj_init_draw_label_dsc ( label->obj, LV_PART_MAIN, &dsc );
+
+    lv_point_t pos
+        = { text_start ( label, label->text ), label->obj->coords.y1 };
+    for ( const char *c = label->text; *c; c++ ) {
+        // Centre narrower digits in the cell, letters outside the clip
+        // area are skipped by the renderer
+        const lv_coord_t cellW = cell_width ( label, *c );
+        const lv_coord_t glyphW = lv_font_get_glyph_width ( dsc.font, *c, 0 );
+        lv_point_t glyphPos = { pos.x + ( cellW - glyphW ) / 2, pos.y };
+        lv_draw_letter ( draw_ctx, &dsc, &glyphPos, *c );
+        pos.x += cellW;
+    }
+}
+
+void numLabelCreate ( num_label_t *label,
+                      lv_obj_t *parent,
+                      const lv_font_t *font,
+                      uint8_t cells )
+{
+    label->obj = lv_obj_create ( parent );
+    label->text [0] = '\0';
+    lv_obj_remove_style_all ( label->obj );
+    lv_obj_set_style_text_font ( label->obj, font, 0 );
+    lv_obj_clear_flag ( label->obj, LV_OBJ_FLAG_CLICKABLE );
+
+    label->digitW = 0;
+    for ( char c = '0'; c <= '9'; c++ ) {
+        label->digitW
+            = MAX ( label->digitW, lv_font_get_glyph_width ( font, c, 0 ) );
+    }
+    lv_obj_set_size ( label->obj,
+                      label->digitW * MIN ( cells, NUM_LABEL_MAX_CELLS ),
+                      lv_font_get_line_height ( font ) );
+    lv_obj_add_event_cb ( label->obj, draw_cb, LV_EVENT_DRAW_MAIN, label );
+}
+
+void numLabelSetText ( num_label_t *label, const char *text )
+{
+    const size_t len = strlen ( text );
+    if ( len > NUM_LABEL_MAX_CELLS ) {
+        return;
+    }
+
+    // Same layout, only the cells that changed are invalidated
+    bool sameLayout = len == strlen ( label->text );
+    for ( size_t i = 0; sameLayout && i < len; i++ ) {
+        sameLayout = cell_width ( label, text [i] )
+                     == cell_width ( label, label->text [i] );
+    }
+    if ( !sameLayout ) {
+        lv_obj_invalidate ( label->obj );
+        memcpy ( label->text, text, len + 1 );
+        return;
+    }
+
+    lv_area_t area = { .y1 = label->obj->coords.y1,
+                       .y2 = label->obj->coords.y2 };
+    lv_coord_t x = text_start ( label, text );
+    for ( size_t i = 0; i < len; i++ ) {
+        const lv_coord_t cellW = cell_width ( label, text [i] );
+        if ( text [i] != label->text [i] ) {
+            area.x1 = x;
+            area.x2 = x + cellW - 1;
+            lv_obj_invalidate_area ( label->obj, &area );
+        }
+        x += cellW;
+    }
+    memcpy ( label->text, text, len + 1 );
+}
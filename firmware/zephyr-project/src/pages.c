@@ -0,0 +1,155 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pages.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "display.h"
+#include "lvPool.h"
+#include "profile.h"
+
+LOG_MODULE_REGISTER ( pages );
+
+static const page_desc_t *const pages [PAGE_CNT]
+    = { [PAGE_MAIN] = &mainPage,
+        [PAGE_CONTROL] = &controlPage,
+        [PAGE_SUMMARY] = &summaryPage,
+        [PAGE_DIAG] = &diagPage,
+        [PAGE_SETTINGS] = &settingsPage };
+static lv_obj_t *screens [PAGE_CNT];
+static page_id_t active = PAGE_MAIN;
+static bike_data_t lastData = {};
+static lv_style_t titleStyle;
+
+static void nav_cb ( lv_event_t *e )
+{
+    const int step = ( intptr_t )lv_event_get_user_data ( e );
+    pageShow ( ( active + PAGE_CNT + step ) % PAGE_CNT );
+}
+
+static void gesture_cb ( lv_event_t *e )
+{
+    const lv_dir_t dir = lv_indev_get_gesture_dir ( lv_indev_get_act() );
+    if ( dir == LV_DIR_LEFT ) {
+        pageShow ( ( active + 1 ) % PAGE_CNT );
+    } else if ( dir == LV_DIR_RIGHT ) {
+        pageShow ( ( active + PAGE_CNT - 1 ) % PAGE_CNT );
+    }
+}
+
+static void press_cb ( lv_event_t *e )
+{
+    displayWake();
+}
+
+static void add_nav ( lv_obj_t *scr, lv_coord_t x, const char *text, int step )
+{
+    lv_obj_t *btn = lv_btn_create ( scr );
+    lv_obj_set_size ( btn, PAGE_NAV_W, PAGE_NAV_H );
+    lv_obj_align ( btn, LV_ALIGN_TOP_LEFT, x, 2 );
+    lv_obj_add_event_cb (
+        btn, nav_cb, LV_EVENT_CLICKED, ( void * )( intptr_t )step );
+
+    lv_obj_t *label = lv_label_create ( btn );
+    lv_label_set_text_static ( label, text );
+    lv_obj_center ( label );
+}
+
+static void setup_screen ( page_id_t id, lv_obj_t *scr )
+{
+    // Horizontal drags are page swipes, not scrolls
+    lv_obj_clear_flag ( scr, LV_OBJ_FLAG_SCROLLABLE );
+    lv_obj_add_event_cb ( scr, gesture_cb, LV_EVENT_GESTURE, NULL );
+    lv_obj_add_event_cb ( scr, press_cb, LV_EVENT_PRESSED, NULL );
+
+    pages [id]->create ( scr );
+    add_nav ( scr, 4, "<", -1 );
+    add_nav ( scr, 8 + PAGE_NAV_W, ">", 1 );
+    if ( pages [id]->title ) {
+        lv_obj_t *title = lv_label_create ( scr );
+        lv_obj_add_style ( title, &titleStyle, 0 );
+        lv_label_set_text_static ( title, pages [id]->title );
+        lv_obj_align ( title, LV_ALIGN_TOP_RIGHT, -8, 4 );
+    }
+    screens [id] = scr;
+}
+
+void pagesInit()
+{
+    lv_style_init ( &titleStyle );
+    lv_style_set_text_font ( &titleStyle, &lv_font_montserrat_24 );
+
+    // The default screen becomes the main page
+    setup_screen ( PAGE_MAIN, lv_scr_act() );
+    active = PAGE_MAIN;
+}
+
+// Only resident pages and the one shown hold LVGL memory
+void pageShow ( page_id_t id )
+{
+    if ( id >= PAGE_CNT || id == active ) {
+        return;
+    }
+
+    PROFILE_SCOPE ( PROF_PAGE_SWITCH );
+    if ( !screens [id] ) {
+        setup_screen ( id, lv_obj_create ( NULL ) );
+    }
+    if ( pages [id]->update ) {
+        pages [id]->update ( &lastData );
+    }
+
+    // No slide animation, every step would be a full screen over SPI
+    const page_id_t prev = active;
+    lv_scr_load ( screens [id] );
+    active = id;
+    if ( !pages [prev]->resident ) {
+        // Can be called from an event on the old screen
+        lv_obj_del_async ( screens [prev] );
+        screens [prev] = NULL;
+    }
+    lv_refr_now ( NULL );
+    LOG_DBG ( "Showing page %d", id );
+}
+
+void pagesUpdate ( const bike_data_t *data )
+{
+    lastData = *data;
+    if ( pages [active]->update ) {
+        pages [active]->update ( data );
+    }
+}
+
+page_stats_t getPageStats()
+{
+    page_stats_t stats = { .active = active };
+#if defined( CONFIG_UBIKE_LV_POOL )
+    const lv_pool_stats_t pool = getLvPoolStats();
+    stats.heap_used = pool.used;
+    stats.heap_peak = pool.peak;
+#else
+    // Only LVGL's built in heap is tracked, zeros with LV_MEM_CUSTOM
+    lv_mem_monitor_t mon;
+    lv_mem_monitor ( &mon );
+    stats.heap_used = mon.total_size - mon.free_size;
+    stats.heap_peak = mon.max_used;
+#endif
+    return stats;
+}
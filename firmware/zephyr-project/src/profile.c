@@ -0,0 +1,113 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+
+#include <string.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/util.h>
+
+static struct k_spinlock profLock;
+static profile_stats_t sections [PROF_SECTION_CNT];
+
+static const char *const names [PROF_SECTION_CNT]
+    = { [PROF_CALC_WATTS] = "calc_watts",
+        [PROF_CREATE_MSG] = "create_msg",
+        [PROF_NEW_MSG] = "new_msg",
+        [PROF_UPDATE_LABELS] = "updateLabels",
+        [PROF_LV_TASK] = "lv_task_handler",
+        [PROF_FLUSH] = "flush",
+        [PROF_PAGE_SWITCH] = "page_switch",
+        [PROF_RIDER_TO_BUS] = "rider_to_bus" };
+
+uint32_t profileCyclesPerSec()
+{
+#if defined( CONFIG_CORTEX_M_DWT )
+    return DT_PROP ( DT_PATH ( cpus, cpu_0 ), clock_frequency );
+#else
+    return sys_clock_hw_cycles_per_sec();
+#endif
+}
+
+void profileSince ( profile_section_t sec, uint32_t start )
+{
+    const uint32_t cycles = profileCycles() - start;
+    const uint32_t bucket = cycles ? 31 - __builtin_clz ( cycles ) : 0;
+
+    k_spinlock_key_t key = k_spin_lock ( &profLock );
+    profile_stats_t *stats = &sections [sec];
+    if ( !stats->count || cycles < stats->min ) {
+        stats->min = cycles;
+    }
+    stats->max = MAX ( stats->max, cycles );
+    stats->total += cycles;
+    stats->count++;
+    stats->hist [bucket]++;
+    k_spin_unlock ( &profLock, key );
+}
+
+void profileScopeEnd ( profile_scope_t *scope )
+{
+    profileSince ( scope->sec, scope->start );
+}
+
+void profileGet ( profile_section_t sec, profile_stats_t *stats )
+{
+    k_spinlock_key_t key = k_spin_lock ( &profLock );
+    *stats = sections [sec];
+    k_spin_unlock ( &profLock, key );
+}
+
+const char *profileName ( profile_section_t sec )
+{
+    return names [sec];
+}
+
+// Upper edge of the bucket holding the percentile, capped at the max
+uint32_t profilePercentile ( const profile_stats_t *stats, uint32_t pct )
+{
+    const uint64_t rank = ( ( uint64_t )stats->count * pct + 99 ) / 100;
+    uint64_t seen = 0;
+    for ( uint32_t i = 0; i < PROFILE_BUCKETS; i++ ) {
+        seen += stats->hist [i];
+        if ( seen && seen >= rank ) {
+            const uint32_t edge = i < 31 ? BIT ( i + 1 ) - 1 : UINT32_MAX;
+            return MIN ( edge, stats->max );
+        }
+    }
+    return stats->max;
+}
+
+void profileReset()
+{
+    k_spinlock_key_t key = k_spin_lock ( &profLock );
+    memset ( sections, 0, sizeof ( sections ) );
+    k_spin_unlock ( &profLock, key );
+}
+
+#if defined( CONFIG_CORTEX_M_DWT )
+static int profile_init ( const struct device *dev )
+{
+    z_arm_dwt_init ( dev );
+    z_arm_dwt_cycle_count_start();
+    return 0;
+}
+
+SYS_INIT ( profile_init, PRE_KERNEL_1, 0 );
+#endif
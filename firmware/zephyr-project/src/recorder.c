@@ -0,0 +1,478 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "recorder.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/fs/littlefs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/crc.h>
+
+#include "telemetry.h"
+
+LOG_MODULE_REGISTER ( recorder );
+
+FS_LITTLEFS_DECLARE_DEFAULT_CONFIG ( lfs_data );
+static struct fs_mount_t lfs_mnt
+    = { .type = FS_LITTLEFS,
+        .fs_data = &lfs_data,
+        .storage_dev = ( void * )FLASH_AREA_ID ( littlefs_storage ),
+        .mnt_point = RECORDER_MNT };
+
+K_MSGQ_DEFINE ( sample_msgq,
+                sizeof ( recorder_sample_t ),
+                RECORDER_QUEUE_LEN,
+                4 );
+
+static const fit_field_def_t fileIdFields []
+    = { { 0, 1, FIT_ENUM },
+        { 1, 2, FIT_UINT16 },
+        { 2, 2, FIT_UINT16 },
+        { 3, 4, FIT_UINT32Z },
+        { 4, 4, FIT_UINT32 } };
+static const fit_field_def_t recordFields [] = { { 253, 4, FIT_UINT32 },
+                                                 { 7, 2, FIT_UINT16 },
+                                                 { 4, 1, FIT_UINT8 },
+                                                 { 9, 2, FIT_SINT16 },
+                                                 { 10, 1, FIT_UINT8 } };
+static const fit_field_def_t lapFields [] = { { 253, 4, FIT_UINT32 },
+                                              { 2, 4, FIT_UINT32 },
+                                              { 7, 4, FIT_UINT32 },
+                                              { 8, 4, FIT_UINT32 },
+                                              { 0, 1, FIT_ENUM },
+                                              { 1, 1, FIT_ENUM } };
+static const fit_field_def_t sessionFields [] = { { 253, 4, FIT_UINT32 },
+                                                  { 2, 4, FIT_UINT32 },
+                                                  { 7, 4, FIT_UINT32 },
+                                                  { 8, 4, FIT_UINT32 },
+                                                  { 26, 2, FIT_UINT16 },
+                                                  { 25, 2, FIT_UINT16 },
+                                                  { 20, 2, FIT_UINT16 },
+                                                  { 21, 2, FIT_UINT16 },
+                                                  { 0, 1, FIT_ENUM },
+                                                  { 1, 1, FIT_ENUM },
+                                                  { 5, 1, FIT_ENUM },
+                                                  { 6, 1, FIT_ENUM },
+                                                  { 18, 1, FIT_UINT8 },
+                                                  { 19, 1, FIT_UINT8 } };
+static const fit_field_def_t activityFields [] = { { 253, 4, FIT_UINT32 },
+                                                   { 0, 4, FIT_UINT32 },
+                                                   { 1, 2, FIT_UINT16 },
+                                                   { 2, 1, FIT_ENUM },
+                                                   { 3, 1, FIT_ENUM },
+                                                   { 4, 1, FIT_ENUM } };
+
+// Only touched by the recorder thread
+typedef struct
+{
+    struct fs_file_t file;
+    bool open;
+    char name [RECORDER_NAME_MAX];
+    uint32_t fileLen;
+    uint32_t start_s;
+    uint32_t lastRecord_s;
+    uint32_t lastPedal_s;
+    uint32_t lastSync_s;
+    uint32_t records;
+    uint32_t sumPower;
+    uint16_t maxPower;
+    uint32_t sumCadence;
+    uint8_t maxCadence;
+    uint32_t maxWrite_ms;  // Longest flash write, for tuning
+} ride_t;
+
+static ride_t ride;
+static uint8_t wbuf [RECORDER_BUF_SIZE];
+static size_t wlen = 0;
+static uint32_t firstRide = 0;
+static uint32_t nextRide = 0;
+static uint32_t dropped = 0;
+
+static void sample_timer_expiry ( struct k_timer *timer )
+{
+    bike_data_t data;
+    telemetryGetSample ( &data );
+
+    recorder_sample_t sample
+        = { .time_s = k_uptime_get_32() / 1000,
+            .watts = data.watts,
+            .rpm = MIN ( data.act_rpm, UINT8_MAX ),
+            .incline = data.tgt_inc,
+            .resistance = data.disp_res };
+    if ( k_msgq_put ( &sample_msgq, &sample, K_NO_WAIT ) ) {
+        dropped++;
+    }
+}
+
+K_TIMER_DEFINE ( sample_timer, sample_timer_expiry, NULL );
+
+static int flush()
+{
+    if ( !wlen ) {
+        return 0;
+    }
+
+    const uint32_t start_ms = k_uptime_get_32();
+    ssize_t rc = fs_write ( &ride.file, wbuf, wlen );
+    ride.maxWrite_ms = MAX ( ride.maxWrite_ms, k_uptime_get_32() - start_ms );
+    if ( rc < 0 ) {
+        LOG_ERR ( "Ride write failed: %d", rc );
+        return rc;
+    }
+    ride.fileLen += wlen;
+    wlen = 0;
+    return 0;
+}
+
+static int put ( const void *data, size_t len )
+{
+    if ( wlen + len > sizeof ( wbuf ) ) {
+        int rc = flush();
+        if ( rc ) {
+            return rc;
+        }
+    }
+    memcpy ( &wbuf [wlen], data, len );
+    wlen += len;
+    return 0;
+}
+
+static int put_def ( fit_local_t local,
+                     uint16_t global,
+                     const fit_field_def_t *fields,
+                     uint8_t numFields )
+{
+    const fit_def_hdr_t hdr = { .header = FIT_DEFINITION | local,
+                                .reserved = 0,
+                                .arch = 0,
+                                .global = global,
+                                .numFields = numFields };
+    int rc = put ( &hdr, sizeof ( hdr ) );
+    if ( rc ) {
+        return rc;
+    }
+    return put ( fields, numFields * sizeof ( fit_field_def_t ) );
+}
+
+static int put_msg ( fit_local_t local, const void *data, size_t len )
+{
+    const uint8_t header = local;
+    int rc = put ( &header, sizeof ( header ) );
+    if ( rc ) {
+        return rc;
+    }
+    return put ( data, len );
+}
+
+static int write_header ( uint32_t dataSize )
+{
+    fit_header_t hdr = { .size = sizeof ( fit_header_t ),
+                         .protocol = FIT_PROTOCOL_VERSION,
+                         .profile = FIT_PROFILE_VERSION,
+                         .dataSize = dataSize,
+                         .type = { '.', 'F', 'I', 'T' } };
+    hdr.crc = crc16_reflect (
+        0xA001, 0, ( uint8_t * )&hdr, offsetof ( fit_header_t, crc ) );
+
+    int rc = fs_seek ( &ride.file, 0, FS_SEEK_SET );
+    if ( rc ) {
+        return rc;
+    }
+    rc = fs_write ( &ride.file, &hdr, sizeof ( hdr ) );
+    return rc < 0 ? rc : 0;
+}
+
+// Rewrites the index and finds the oldest and next ride numbers
+static void scan_rides()
+{
+    struct fs_dir_t dir;
+    struct fs_dirent entry;
+    struct fs_file_t index;
+    char line [RECORDER_NAME_MAX + 12];
+
+    fs_dir_t_init ( &dir );
+    fs_file_t_init ( &index );
+    fs_unlink ( RECORDER_INDEX );
+    if ( fs_open ( &index, RECORDER_INDEX, FS_O_CREATE | FS_O_WRITE ) ) {
+        LOG_ERR ( "Failed to create ride index!" );
+        return;
+    }
+    if ( fs_opendir ( &dir, RECORDER_MNT ) ) {
+        fs_close ( &index );
+        return;
+    }
+
+    firstRide = UINT32_MAX;
+    nextRide = 0;
+    while ( !fs_readdir ( &dir, &entry ) && entry.name [0] ) {
+        if ( entry.type != FS_DIR_ENTRY_FILE
+             || strncmp ( entry.name, "ride", 4 ) ) {
+            continue;
+        }
+        const uint32_t num = strtoul ( &entry.name [4], NULL, 10 );
+        firstRide = MIN ( firstRide, num );
+        nextRide = MAX ( nextRide, num + 1 );
+        int len = snprintf (
+            line, sizeof ( line ), "%s,%u\n", entry.name, entry.size );
+        fs_write ( &index, line, len );
+    }
+    fs_closedir ( &dir );
+    fs_close ( &index );
+    if ( firstRide == UINT32_MAX ) {
+        firstRide = nextRide;
+    }
+}
+
+static void make_room()
+{
+    struct fs_statvfs stat;
+    char name [RECORDER_NAME_MAX];
+    while ( firstRide < nextRide && !fs_statvfs ( RECORDER_MNT, &stat )
+            && stat.f_bfree * stat.f_frsize < RECORDER_MIN_FREE ) {
+        snprintf ( name,
+                   sizeof ( name ),
+                   RECORDER_MNT "/ride%04u.fit",
+                   firstRide );
+        LOG_INF ( "Deleting %s to make room", name );
+        fs_unlink ( name );
+        firstRide++;
+    }
+}
+
+static void open_ride ( uint32_t now_s )
+{
+    make_room();
+
+    memset ( &ride, 0, sizeof ( ride ) );
+    fs_file_t_init ( &ride.file );
+    snprintf ( ride.name,
+               sizeof ( ride.name ),
+               RECORDER_MNT "/ride%04u.fit",
+               nextRide );
+    int rc = fs_open ( &ride.file, ride.name, FS_O_CREATE | FS_O_RDWR );
+    if ( rc ) {
+        LOG_ERR ( "Failed to open %s: %d", ride.name, rc );
+        return;
+    }
+    nextRide++;
+    ride.open = true;
+    ride.start_s = now_s;
+    ride.lastSync_s = now_s;
+    wlen = 0;
+
+    // Placeholder header, the size and CRC are filled in on close
+    if ( write_header ( 0 ) ) {
+        LOG_ERR ( "Failed to write FIT header!" );
+    }
+    ride.fileLen = sizeof ( fit_header_t );
+
+    const fit_file_id_t fileId = { .type = FIT_FILE_ACTIVITY,
+                                   .manufacturer = FIT_MANUFACTURER_DEVELOPMENT,
+                                   .product = 0,
+                                   .serial = 0,
+                                   .timeCreated = now_s };
+    put_def ( FIT_LOCAL_FILE_ID,
+              FIT_MESG_FILE_ID,
+              fileIdFields,
+              ARRAY_SIZE ( fileIdFields ) );
+    put_msg ( FIT_LOCAL_FILE_ID, &fileId, sizeof ( fileId ) );
+    put_def ( FIT_LOCAL_RECORD,
+              FIT_MESG_RECORD,
+              recordFields,
+              ARRAY_SIZE ( recordFields ) );
+
+    LOG_INF ( "Recording %s", ride.name );
+}
+
+static void write_record ( const recorder_sample_t *sample )
+{
+    const fit_record_t record
+        = { .timestamp = sample->time_s,
+            .power = sample->watts,
+            .cadence = sample->rpm,
+            .grade = ( sample->incline - 20 ) * 50,
+            .resistance = sample->resistance };
+    put_msg ( FIT_LOCAL_RECORD, &record, sizeof ( record ) );
+
+    ride.records++;
+    ride.lastRecord_s = sample->time_s;
+    ride.sumPower += sample->watts;
+    ride.maxPower = MAX ( ride.maxPower, sample->watts );
+    ride.sumCadence += sample->rpm;
+    ride.maxCadence = MAX ( ride.maxCadence, sample->rpm );
+}
+
+static int append_crc()
+{
+    uint16_t crc = 0;
+    int rc = fs_seek ( &ride.file, 0, FS_SEEK_SET );
+    for ( uint32_t pos = 0; !rc && pos < ride.fileLen; ) {
+        ssize_t len = fs_read (
+            &ride.file, wbuf, MIN ( sizeof ( wbuf ), ride.fileLen - pos ) );
+        if ( len <= 0 ) {
+            rc = len ? len : -EIO;
+            break;
+        }
+        crc = crc16_reflect ( 0xA001, crc, wbuf, len );
+        pos += len;
+    }
+    if ( rc ) {
+        return rc;
+    }
+    ssize_t len = fs_write ( &ride.file, &crc, sizeof ( crc ) );
+    return len < 0 ? len : 0;
+}
+
+static void close_ride()
+{
+    const uint32_t elapsed_ms = ( ride.lastRecord_s - ride.start_s ) * 1000;
+    const uint32_t timer_ms = ride.records * 1000;
+    const uint32_t records = MAX ( ride.records, 1 );
+
+    const fit_lap_t lap = { .timestamp = ride.lastRecord_s,
+                            .startTime = ride.start_s,
+                            .totalElapsed = elapsed_ms,
+                            .totalTimer = timer_ms,
+                            .event = FIT_EVENT_LAP,
+                            .eventType = FIT_EVENT_TYPE_STOP };
+    const fit_session_t session
+        = { .timestamp = ride.lastRecord_s,
+            .startTime = ride.start_s,
+            .totalElapsed = elapsed_ms,
+            .totalTimer = timer_ms,
+            .numLaps = 1,
+            .firstLapIndex = 0,
+            .avgPower = ride.sumPower / records,
+            .maxPower = ride.maxPower,
+            .event = FIT_EVENT_SESSION,
+            .eventType = FIT_EVENT_TYPE_STOP,
+            .sport = FIT_SPORT_CYCLING,
+            .subSport = FIT_SUB_SPORT_INDOOR_CYCLING,
+            .avgCadence = ride.sumCadence / records,
+            .maxCadence = ride.maxCadence };
+    const fit_activity_t activity = { .timestamp = ride.lastRecord_s,
+                                      .totalTimer = timer_ms,
+                                      .numSessions = 1,
+                                      .type = FIT_ACTIVITY_MANUAL,
+                                      .event = FIT_EVENT_ACTIVITY,
+                                      .eventType = FIT_EVENT_TYPE_STOP };
+    put_def (
+        FIT_LOCAL_LAP, FIT_MESG_LAP, lapFields, ARRAY_SIZE ( lapFields ) );
+    put_msg ( FIT_LOCAL_LAP, &lap, sizeof ( lap ) );
+    put_def ( FIT_LOCAL_SESSION,
+              FIT_MESG_SESSION,
+              sessionFields,
+              ARRAY_SIZE ( sessionFields ) );
+    put_msg ( FIT_LOCAL_SESSION, &session, sizeof ( session ) );
+    put_def ( FIT_LOCAL_ACTIVITY,
+              FIT_MESG_ACTIVITY,
+              activityFields,
+              ARRAY_SIZE ( activityFields ) );
+    put_msg ( FIT_LOCAL_ACTIVITY, &activity, sizeof ( activity ) );
+
+    int rc = flush();
+    if ( !rc ) {
+        rc = write_header ( ride.fileLen - sizeof ( fit_header_t ) );
+    }
+    if ( !rc ) {
+        rc = append_crc();
+    }
+    if ( rc ) {
+        LOG_ERR ( "Failed to finish %s: %d", ride.name, rc );
+    }
+    fs_close ( &ride.file );
+    ride.open = false;
+
+    LOG_INF ( "Closed %s, %u records, %u bytes, longest write %u ms",
+              ride.name,
+              ride.records,
+              ride.fileLen + sizeof ( uint16_t ),
+              ride.maxWrite_ms );
+    scan_rides();
+}
+
+static void handle_sample ( const recorder_sample_t *sample )
+{
+    if ( sample->rpm ) {
+        ride.lastPedal_s = sample->time_s;
+        if ( !ride.open ) {
+            open_ride ( sample->time_s );
+            ride.lastPedal_s = sample->time_s;
+        }
+    }
+    if ( !ride.open ) {
+        return;
+    }
+
+    if ( sample->rpm ) {
+        write_record ( sample );
+    } else if ( sample->time_s - ride.lastPedal_s >= RECORDER_IDLE_CLOSE_S ) {
+        close_ride();
+        return;
+    }
+
+    // Periodically commit so a power cut loses little
+    if ( sample->time_s - ride.lastSync_s >= RECORDER_SYNC_S ) {
+        ride.lastSync_s = sample->time_s;
+        if ( !flush() ) {
+            fs_sync ( &ride.file );
+        }
+    }
+}
+
+static void recorder_thread ( void *p1, void *p2, void *p3 )
+{
+    int rc = fs_mount ( &lfs_mnt );
+    if ( rc ) {
+        LOG_ERR ( "Failed to mount %s: %d", RECORDER_MNT, rc );
+        return;
+    }
+    scan_rides();
+    LOG_INF ( "Recorder ready, %u rides stored", nextRide - firstRide );
+
+    k_timer_start ( &sample_timer,
+                    K_MSEC ( RECORDER_PERIOD_MS ),
+                    K_MSEC ( RECORDER_PERIOD_MS ) );
+
+    recorder_sample_t sample;
+    while ( 1 ) {
+        k_msgq_get ( &sample_msgq, &sample, K_FOREVER );
+        handle_sample ( &sample );
+        if ( dropped ) {
+            LOG_WRN ( "Recorder dropped %u samples", dropped );
+            dropped = 0;
+        }
+    }
+}
+
+K_THREAD_DEFINE ( recorder_tid,
+                  RECORDER_STACKSIZE,
+                  recorder_thread,
+                  NULL,
+                  NULL,
+                  NULL,
+                  RECORDER_PRIORITY,
+                  0,
+                  0 );
@@ -0,0 +1,141 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "telemetry.h"
+
+#include <errno.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "trace.h"
+
+LOG_MODULE_REGISTER ( telemetry );
+
+static struct k_spinlock sampleLock;
+static bike_data_t sample = {};
+static uint32_t sampleSeq = 0;
+static telemetry_frame_t *frames [TELEMETRY_MAX_FRAMES];
+static size_t frameCnt = 0;
+
+int telemetryRegister ( telemetry_frame_t *frame )
+{
+    if ( frameCnt >= TELEMETRY_MAX_FRAMES ) {
+        LOG_ERR ( "Too many telemetry frames!" );
+        return -ENOMEM;
+    }
+
+    frame->attr = bt_gatt_find_by_uuid (
+        frame->svc->attrs, frame->svc->attr_count, frame->uuid );
+    if ( !frame->attr ) {
+        LOG_ERR ( "Telemetry characteristic not found!" );
+        return -ENOENT;
+    }
+    frames [frameCnt++] = frame;
+    return 0;
+}
+
+uint32_t telemetryGetSample ( bike_data_t *data )
+{
+    k_spinlock_key_t key = k_spin_lock ( &sampleLock );
+    *data = sample;
+    uint32_t seq = sampleSeq;
+    k_spin_unlock ( &sampleLock, key );
+    return seq;
+}
+
+static void notify_sent ( struct bt_conn *conn, void *user_data )
+{
+    telemetry_frame_t *frame = user_data;
+    atomic_t *inflight = &frame->inflight [bt_conn_index ( conn )];
+    if ( atomic_get ( inflight ) > 0 ) {
+        atomic_dec ( inflight );
+    }
+}
+
+static void notify_conn ( struct bt_conn *conn, void *user_data )
+{
+    telemetry_frame_t *frame = user_data;
+    if ( !bt_gatt_is_subscribed ( conn, frame->attr, BT_GATT_CCC_NOTIFY ) ) {
+        return;
+    }
+
+    // A link that hasn't drained the last sample skips this one
+    atomic_t *inflight = &frame->inflight [bt_conn_index ( conn )];
+    if ( atomic_get ( inflight ) >= TELEMETRY_MAX_INFLIGHT ) {
+        frame->dropped++;
+        traceRecord ( TRACE_NOTIFY,
+                      BT_UUID_16 ( frame->uuid )->val,
+                      bt_conn_index ( conn ),
+                      -EBUSY,
+                      0 );
+        return;
+    }
+
+    // Encode at most once per sample, shared by every connection
+    if ( frame->seq != sampleSeq ) {
+        frame->len = frame->encode ( &sample, frame->buf );
+        frame->seq = sampleSeq;
+        frame->encoded++;
+    }
+
+    struct bt_gatt_notify_params params = { .attr = frame->attr,
+                                            .data = frame->buf,
+                                            .len = frame->len,
+                                            .func = notify_sent,
+                                            .user_data = frame };
+    atomic_inc ( inflight );
+    int rc = bt_gatt_notify_cb ( conn, &params );
+    traceRecord ( TRACE_NOTIFY,
+                  BT_UUID_16 ( frame->uuid )->val,
+                  bt_conn_index ( conn ),
+                  rc,
+                  frame->len );
+    if ( rc ) {
+        atomic_dec ( inflight );
+        if ( rc != -ENOTCONN ) {
+            LOG_WRN ( "Telemetry notify failed: %d", rc );
+        }
+        return;
+    }
+    frame->sent++;
+}
+
+void telemetryPublish ( bike_data_t data )
+{
+    k_spinlock_key_t key = k_spin_lock ( &sampleLock );
+    sample = data;
+    sampleSeq++;
+    k_spin_unlock ( &sampleLock, key );
+
+    for ( size_t i = 0; i < frameCnt; i++ ) {
+        bt_conn_foreach ( BT_CONN_TYPE_LE, notify_conn, frames [i] );
+    }
+}
+
+static void telemetry_disconnected ( struct bt_conn *conn, uint8_t reason )
+{
+    ARG_UNUSED ( reason );
+    for ( size_t i = 0; i < frameCnt; i++ ) {
+        atomic_set ( &frames [i]->inflight [bt_conn_index ( conn )], 0 );
+    }
+}
+
+BT_CONN_CB_DEFINE ( telemetry_conn_callbacks )
+    = { .disconnected = telemetry_disconnected };
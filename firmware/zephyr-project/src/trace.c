@@ -0,0 +1,75 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include <SEGGER_RTT.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER ( trace );
+
+BUILD_ASSERT ( sizeof ( trace_rec_t ) == 16 );
+BUILD_ASSERT ( CONFIG_UBIKE_TRACE_RTT_BUFFER
+               < CONFIG_SEGGER_RTT_MAX_NUM_UP_BUFFERS );
+
+static struct k_spinlock traceLock;
+static uint16_t traceSeq = 0;
+static uint8_t traceBuf [CONFIG_UBIKE_TRACE_BUFFER_SIZE];
+
+// Callable from ISRs, a record that doesn't fit is skipped, never split
+void traceRecord ( trace_type_t type,
+                   uint16_t a,
+                   uint16_t b,
+                   uint16_t c,
+                   uint16_t d )
+{
+    trace_rec_t rec = { .sync = TRACE_SYNC,
+                        .type = type,
+                        .a = a,
+                        .b = b,
+                        .c = c,
+                        .d = d };
+
+    // Own up buffer, only needs to serialize against itself.  Time is
+    // taken with the sequence number so both are in the same order.
+    k_spinlock_key_t key = k_spin_lock ( &traceLock );
+    rec.seq = traceSeq++;
+    rec.time_us = k_ticks_to_us_floor32 ( k_uptime_ticks() );
+    SEGGER_RTT_WriteNoLock (
+        CONFIG_UBIKE_TRACE_RTT_BUFFER, &rec, sizeof ( rec ) );
+    k_spin_unlock ( &traceLock, key );
+}
+
+static int trace_init ( const struct device *dev )
+{
+    ARG_UNUSED ( dev );
+
+    int ret = SEGGER_RTT_ConfigUpBuffer ( CONFIG_UBIKE_TRACE_RTT_BUFFER,
+                                          "Trace",
+                                          traceBuf,
+                                          sizeof ( traceBuf ),
+                                          SEGGER_RTT_MODE_NO_BLOCK_SKIP );
+    if ( ret < 0 ) {
+        LOG_ERR ( "Trace RTT buffer config failed: %d", ret );
+    }
+    return 0;
+}
+
+SYS_INIT ( trace_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
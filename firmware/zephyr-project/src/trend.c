@@ -0,0 +1,93 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trend.h"
+
+#include <zephyr/kernel.h>
+
+// Chart series point straight at these rings, shift mode only moves the
+// start index so appending never copies the history
+static lv_coord_t pwrPoints [TREND_POINTS];
+static lv_coord_t rpmPoints [TREND_POINTS];
+static lv_obj_t *chart;
+static lv_chart_series_t *pwrSer;
+static lv_chart_series_t *rpmSer;
+
+// Samples being averaged into the next point
+static uint32_t pwrSum = 0;
+static uint32_t rpmSum = 0;
+static uint32_t sampleCnt = 0;
+static uint32_t lastPoint_ms = 0;
+
+lv_obj_t *trendCreate ( lv_obj_t *parent, lv_coord_t w, lv_coord_t h )
+{
+    for ( size_t i = 0; i < TREND_POINTS; i++ ) {
+        pwrPoints [i] = LV_CHART_POINT_NONE;
+        rpmPoints [i] = LV_CHART_POINT_NONE;
+    }
+
+    chart = lv_chart_create ( parent );
+    lv_obj_set_size ( chart, w, h );
+    lv_chart_set_type ( chart, LV_CHART_TYPE_LINE );
+    lv_chart_set_update_mode ( chart, LV_CHART_UPDATE_MODE_SHIFT );
+    lv_chart_set_point_count ( chart, TREND_POINTS );
+    lv_chart_set_div_line_count ( chart, 0, 0 );
+    lv_chart_set_range ( chart, LV_CHART_AXIS_PRIMARY_Y, 0, TREND_PWR_MAX );
+    lv_chart_set_range ( chart, LV_CHART_AXIS_SECONDARY_Y, 0, TREND_RPM_MAX );
+    lv_obj_set_style_size ( chart, 0, LV_PART_INDICATOR );
+    lv_obj_set_style_line_width ( chart, 2, LV_PART_ITEMS );
+    lv_obj_set_style_pad_all ( chart, 2, 0 );
+    lv_obj_clear_flag ( chart, LV_OBJ_FLAG_CLICKABLE );
+
+    pwrSer = lv_chart_add_series ( chart,
+                                   lv_palette_main ( LV_PALETTE_RED ),
+                                   LV_CHART_AXIS_PRIMARY_Y );
+    rpmSer = lv_chart_add_series ( chart,
+                                   lv_palette_main ( LV_PALETTE_BLUE ),
+                                   LV_CHART_AXIS_SECONDARY_Y );
+    lv_chart_set_ext_y_array ( chart, pwrSer, pwrPoints );
+    lv_chart_set_ext_y_array ( chart, rpmSer, rpmPoints );
+
+    lastPoint_ms = k_uptime_get_32();
+    return chart;
+}
+
+// Call from the display thread with each new sample
+void trendSample ( bike_data_t data )
+{
+    pwrSum += data.watts;
+    rpmSum += data.act_rpm;
+    sampleCnt++;
+
+    const uint32_t now_ms = k_uptime_get_32();
+    if ( now_ms - lastPoint_ms < TREND_PERIOD_MS ) {
+        return;
+    }
+    lv_chart_set_next_value ( chart, pwrSer, pwrSum / sampleCnt );
+    lv_chart_set_next_value ( chart, rpmSer, rpmSum / sampleCnt );
+    pwrSum = 0;
+    rpmSum = 0;
+    sampleCnt = 0;
+
+    // Points stay on the period grid despite sample jitter, but after a
+    // long gap start over rather than add a burst of points
+    lastPoint_ms += TREND_PERIOD_MS;
+    if ( now_ms - lastPoint_ms >= TREND_PERIOD_MS ) {
+        lastPoint_ms = now_ms;
+    }
+}
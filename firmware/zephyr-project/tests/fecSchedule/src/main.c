@@ -0,0 +1,87 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "fec.h"
+#include "fecSchedule.h"
+
+// Two passes so gaps across the wrap are measured
+#define WALK_LEN ( 2 * FEC_SCHEDULE_LEN )
+
+// Longest run of messages between sends of page, counting the send
+static uint16_t max_gap ( uint8_t page )
+{
+    int last = -1;
+    uint16_t gap = 0;
+    for ( int cnt = 0; cnt < WALK_LEN; cnt++ ) {
+        if ( fecScheduledPage ( cnt % FEC_SCHEDULE_LEN ) != page ) {
+            continue;
+        }
+        if ( last >= 0 ) {
+            gap = MAX ( gap, cnt - last );
+        }
+        last = cnt;
+    }
+    zassert_true ( last >= 0, "Page %02x never sent", page );
+    return gap;
+}
+
+// Longest gap between the starts of consecutive pairs
+static uint16_t max_pair_gap ( uint8_t page )
+{
+    int last = -1;
+    uint16_t gap = 0;
+    for ( int cnt = 0; cnt < WALK_LEN - 1; cnt++ ) {
+        if ( fecScheduledPage ( cnt % FEC_SCHEDULE_LEN ) != page
+             || fecScheduledPage ( ( cnt + 1 ) % FEC_SCHEDULE_LEN )
+                    != page ) {
+            continue;
+        }
+        if ( last >= 0 ) {
+            gap = MAX ( gap, cnt - last );
+        }
+        last = cnt++;
+    }
+    zassert_true ( last >= 0, "Page %02x never sent twice in a row", page );
+    return gap;
+}
+
+ZTEST ( fec_schedule, test_general_data )
+{
+    zassert_true ( max_gap ( FEC_GENERAL_FE_DATA_PG ) <= 5 );
+}
+
+ZTEST ( fec_schedule, test_bike_data )
+{
+    zassert_true ( max_gap ( FEC_STATIONARY_BIKE_DATA_PG ) <= 5 );
+}
+
+ZTEST ( fec_schedule, test_general_settings )
+{
+    zassert_true ( max_gap ( FEC_GENERAL_SETTINGS_PG ) <= 20 );
+}
+
+ZTEST ( fec_schedule, test_common_pages )
+{
+    zassert_true ( max_pair_gap ( FEC_COMMON_MANUFACTURER_IDENT_PG ) <= 132 );
+    zassert_true ( max_pair_gap ( FEC_COMMON_PRODUCT_INFORMATION_PG )
+                   <= 132 );
+}
+
+ZTEST_SUITE ( fec_schedule, NULL, NULL, NULL, NULL, NULL );
@@ -0,0 +1,63 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <zephyr/ztest.h>
+
+#include "numFmt.h"
+#include "profile.h"
+
+#define BENCH_RUNS 1000
+
+// Cycles per call averaged over the runs, DWT where the core has one
+#define BENCH( _name, _call )                                         \
+    do {                                                              \
+        const uint32_t start = profileCycles();                       \
+        for ( uint32_t i = 0; i < BENCH_RUNS; i++ ) {                 \
+            _call;                                                    \
+        }                                                             \
+        const uint32_t cycles = profileCycles() - start;              \
+        TC_PRINT ( "%-24s %u cycles\n", _name, cycles / BENCH_RUNS ); \
+    } while ( 0 )
+
+// Values written through volatile so the calls aren't hoisted
+static volatile uint32_t watts = 1234;
+static volatile int32_t tenths = -55;
+
+ZTEST ( num_fmt_bench, test_uint_vs_snprintf )
+{
+    char buf [5];
+    BENCH ( "NUM_FMT_UINT", NUM_FMT_UINT ( buf, watts ) );
+    BENCH ( "snprintf %u", snprintf ( buf, sizeof ( buf ), "%u", watts ) );
+}
+
+ZTEST ( num_fmt_bench, test_fixed_vs_snprintf )
+{
+    char buf [7];
+    BENCH ( "numFmtFixed",
+            numFmtFixed ( buf, sizeof ( buf ), tenths, 1 ) );
+    BENCH ( "snprintf %d.%d",
+            snprintf ( buf,
+                       sizeof ( buf ),
+                       "%d.%d",
+                       tenths / 10,
+                       abs ( tenths % 10 ) ) );
+}
+
+ZTEST_SUITE ( num_fmt_bench, NULL, NULL, NULL, NULL, NULL );
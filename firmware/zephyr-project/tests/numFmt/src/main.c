@@ -0,0 +1,123 @@
+/*
+ * Universal Bike Controller
+ * Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "numFmt.h"
+
+ZTEST ( num_fmt, test_uint )
+{
+    char buf [11];
+    zassert_equal ( NUM_FMT_UINT ( buf, 0 ), 1 );
+    zassert_str_equal ( buf, "0" );
+    zassert_equal ( NUM_FMT_UINT ( buf, 120 ), 3 );
+    zassert_str_equal ( buf, "120" );
+    zassert_equal ( NUM_FMT_UINT ( buf, UINT32_MAX ), 10 );
+    zassert_str_equal ( buf, "4294967295" );
+}
+
+// Display strings saturate to all nines instead of overflowing
+ZTEST ( num_fmt, test_uint_saturates )
+{
+    char pwrString [5];
+    zassert_equal ( NUM_FMT_UINT ( pwrString, 65535 ), 4 );
+    zassert_str_equal ( pwrString, "9999" );
+
+    char rpmString [4];
+    zassert_equal ( NUM_FMT_UINT ( rpmString, 1000 ), 3 );
+    zassert_str_equal ( rpmString, "999" );
+}
+
+ZTEST ( num_fmt, test_uint_small_buffer )
+{
+    char buf [2] = { 'x', 'x' };
+    zassert_equal ( numFmtUint ( buf, 0, 5 ), 0 );
+    zassert_equal ( buf [0], 'x' );
+    zassert_equal ( numFmtUint ( buf, 1, 5 ), 0 );
+    zassert_str_equal ( buf, "" );
+}
+
+ZTEST ( num_fmt, test_fixed )
+{
+    char buf [16];
+    zassert_equal ( NUM_FMT_FIXED ( buf, 0, 1 ), 3 );
+    zassert_str_equal ( buf, "0.0" );
+    zassert_equal ( NUM_FMT_FIXED ( buf, 12345, 2 ), 6 );
+    zassert_str_equal ( buf, "123.45" );
+    zassert_equal ( NUM_FMT_FIXED ( buf, 7, 0 ), 1 );
+    zassert_str_equal ( buf, "7" );
+}
+
+ZTEST ( num_fmt, test_fixed_negative )
+{
+    char buf [16];
+    zassert_equal ( NUM_FMT_FIXED ( buf, -105, 1 ), 5 );
+    zassert_str_equal ( buf, "-10.5" );
+    zassert_equal ( NUM_FMT_FIXED ( buf, -5, 1 ), 4 );
+    zassert_str_equal ( buf, "-0.5" );
+    zassert_equal ( NUM_FMT_FIXED ( buf, INT32_MIN, 0 ), 11 );
+    zassert_str_equal ( buf, "-2147483648" );
+}
+
+ZTEST ( num_fmt, test_fixed_saturates )
+{
+    char buf [6];  // "-99.9"
+    zassert_equal ( NUM_FMT_FIXED ( buf, -1000, 1 ), 5 );
+    zassert_str_equal ( buf, "-99.9" );
+    zassert_equal ( NUM_FMT_FIXED ( buf, 1000, 1 ), 5 );
+    zassert_str_equal ( buf, "100.0" );
+    zassert_equal ( NUM_FMT_FIXED ( buf, 10000, 1 ), 5 );
+    zassert_str_equal ( buf, "999.9" );
+}
+
+// Less room than "0.x" plus terminator gives an empty string
+ZTEST ( num_fmt, test_fixed_too_small )
+{
+    char buf [8];
+    zassert_equal ( numFmtFixed ( buf, 3, 5, 1 ), 0 );
+    zassert_str_equal ( buf, "" );
+    zassert_equal ( numFmtFixed ( buf, 4, -5, 1 ), 0 );
+    zassert_str_equal ( buf, "" );
+    zassert_equal ( numFmtFixed ( buf, 4, 5, 2 ), 0 );
+    zassert_str_equal ( buf, "" );
+}
+
+ZTEST ( num_fmt, test_pad )
+{
+    char buf [4] = { 0 };
+    numFmtPad ( buf, 2, 7 );
+    zassert_str_equal ( buf, "07" );
+    numFmtPad ( buf, 2, 123 );
+    zassert_str_equal ( buf, "99" );
+    numFmtPad ( buf, 3, 0 );
+    zassert_str_equal ( buf, "000" );
+}
+
+ZTEST ( num_fmt, test_incline )
+{
+    char incString [7];  // -10.0%
+    zassert_equal ( numFmtIncline ( incString, sizeof ( incString ), 0 ), 6 );
+    zassert_str_equal ( incString, "-10.0%" );
+    zassert_equal ( numFmtIncline ( incString, sizeof ( incString ), 21 ), 4 );
+    zassert_str_equal ( incString, "0.5%" );
+    zassert_equal ( numFmtIncline ( incString, sizeof ( incString ), 60 ), 5 );
+    zassert_str_equal ( incString, "20.0%" );
+}
+
+ZTEST_SUITE ( num_fmt, NULL, NULL, NULL, NULL, NULL );
@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+
+# Universal Bike Controller
+# Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import asyncio
+import struct
+import time
+
+from bleak import BleakScanner
+
+COMPANY_ID = 0xFFFF
+# companyId is stripped by bleak, see broadcast_data_t
+FORMAT = '<HBHBBh'
+REPORT_SECS = 5
+
+bikes = {}
+
+def onAdvertisement(device, adv):
+    data = adv.manufacturer_data.get(COMPANY_ID)
+    if data is None or len(data) < struct.calcsize(FORMAT):
+        return
+    bikeId, seq, watts, rpm, res, inc = struct.unpack_from(FORMAT, data)
+    now = time.monotonic()
+    bike = bikes.setdefault(bikeId, {'seq': None, 'last': now, 'rx': 0,
+                                     'lost': 0, 'gapMax': 0.0})
+    if bike['seq'] is not None:
+        if seq == bike['seq']:
+            return  # Same update seen on another channel/interval
+        bike['lost'] += (seq - bike['seq'] - 1) & 0xFF
+        bike['gapMax'] = max(bike['gapMax'], now - bike['last'])
+    bike.update(seq=seq, last=now, watts=watts, rpm=rpm, res=res,
+                inc=inc / 10.0)
+    bike['rx'] += 1
+
+async def main():
+    scanner = BleakScanner(onAdvertisement)
+    await scanner.start()
+    try:
+        while True:
+            await asyncio.sleep(REPORT_SECS)
+            print('Bike   Watts  Rpm  Res  Inc%   Rx  Lost  MaxGap(s)')
+            for bikeId, b in sorted(bikes.items(),
+                                    key=lambda kv: -kv[1].get('watts', 0)):
+                print('%5u  %5u  %3u  %3u  %4.1f  %4u  %4u  %6.2f' % (
+                    bikeId, b['watts'], b['rpm'], b['res'], b['inc'],
+                    b['rx'], b['lost'], b['gapMax']))
+    finally:
+        await scanner.stop()
+
+if __name__ == '__main__':
+    asyncio.run(main())
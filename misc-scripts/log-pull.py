@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+
+# Universal Bike Controller
+# Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import asyncio
+import os
+import struct
+import subprocess
+import sys
+
+import cbor2
+from bleak import BleakClient, BleakScanner
+
+# Usage: log-pull.py <build dir> [output.bin]
+# Drains the dictionary log ring over SMP (group 64, id 2) and decodes it
+# with Zephyr's log parser and the build's log_dictionary.json.
+PEER_NAME = 'uBike FTMS'
+SMP_CHAR = 'da2e7828-fbce-4e01-ae9e-261174997c48'
+SMP_HDR = '>BBHHBB'  # op, flags, len, group, seq, id
+GROUP = 64
+ID_LOG = 2
+
+class SmpClient:
+    def __init__ ( self, client ):
+        self.client = client
+        self.seq = 0
+        self.rx = bytearray()
+        self.done = asyncio.Event()
+
+    def onNotify ( self, sender, data ):
+        self.rx += data
+        hdrLen = struct.calcsize(SMP_HDR)
+        if len(self.rx) >= hdrLen:
+            _, _, length, _, _, _ = struct.unpack_from(SMP_HDR, self.rx)
+            if len(self.rx) >= hdrLen + length:
+                self.done.set()
+
+    async def read ( self, group, cmdId ):
+        payload = cbor2.dumps({})
+        self.seq = (self.seq + 1) & 0xFF
+        hdr = struct.pack(SMP_HDR, 0, 0, len(payload), group, self.seq, cmdId)
+        self.rx = bytearray()
+        self.done.clear()
+        await self.client.write_gatt_char(SMP_CHAR, hdr + payload, False)
+        await asyncio.wait_for(self.done.wait(), 5)
+        return cbor2.loads(self.rx[struct.calcsize(SMP_HDR):])
+
+async def pull ( output ):
+    device = await BleakScanner.find_device_by_name(PEER_NAME)
+    if device is None:
+        sys.exit('Bike not found')
+    async with BleakClient(device) as client:
+        smp = SmpClient(client)
+        await client.start_notify(SMP_CHAR, smp.onNotify)
+        with open(output, 'wb') as f:
+            while True:
+                rsp = await smp.read(GROUP, ID_LOG)
+                if rsp.get('dropped'):
+                    print('%u messages dropped on the bike' % rsp['dropped'])
+                if not rsp.get('data'):
+                    break
+                f.write(rsp['data'])
+
+if __name__ == '__main__':
+    build = sys.argv[1]
+    output = sys.argv[2] if len(sys.argv) > 2 else 'log.bin'
+    asyncio.run(pull(output))
+
+    parser = os.path.join(os.environ['ZEPHYR_BASE'],
+                          'scripts', 'logging', 'dictionary', 'log_parser.py')
+    database = os.path.join(build, 'zephyr', 'log_dictionary.json')
+    subprocess.run([sys.executable, parser, database, output], check = True)
@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+
+# Universal Bike Controller
+# Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import os
+import subprocess
+import sys
+import time
+
+# Usage: ota-bench.py <image.bin> [runs] [interrupt_secs]
+# Uploads with the mcumgr CLI over BLE and reports throughput.  With
+# interrupt_secs the first attempt is killed part way and the upload is
+# restarted to check it resumes from the last written offset.
+PEER_NAME = 'uBike FTMS'
+CONNSTRING = 'ctlr_name=hci0,peer_name=' + PEER_NAME
+
+def upload ( image, timeout = None ):
+    cmd = ['mcumgr', '--conntype', 'ble', '--connstring', CONNSTRING,
+           'image', 'upload', image]
+    start = time.monotonic()
+    try:
+        subprocess.run(cmd, check = True, timeout = timeout)
+    except subprocess.TimeoutExpired:
+        return None
+    return time.monotonic() - start
+
+if __name__ == '__main__':
+    image = sys.argv[1]
+    runs = int(sys.argv[2]) if len(sys.argv) > 2 else 3
+    interrupt = float(sys.argv[3]) if len(sys.argv) > 3 else None
+    kb = os.path.getsize(image) / 1024.0
+
+    results = []
+    for run in range(runs):
+        total = 0.0
+        secs = None
+        if interrupt:
+            # Finishing before the timeout means nothing left to resume
+            secs = upload(image, interrupt)
+            if secs is None:
+                total += interrupt
+            else:
+                print('Run %d: finished before the interrupt' % (run + 1))
+        if secs is None:
+            secs = upload(image)
+        total += secs
+        results.append(total)
+        print('Run %d: %.1f KB in %.1f s, %.2f KB/s' % (
+            run + 1, kb, total, kb / total))
+
+    avg = sum(results) / len(results)
+    print('Average: %.1f s, %.2f KB/s' % (avg, kb / avg))
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+
+# Universal Bike Controller
+# Copyright (C) 2022-2023, Greco Engineering Solutions LLC
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import csv
+import struct
+import sys
+
+# Usage: trace-decode.py <trace.bin> <output.csv|output.parquet>
+# Decodes the CONFIG_UBIKE_TRACE stream captured from RTT buffer 2, e.g.
+#   JLinkRTTLogger -Device NRF52840_XXAA -If SWD -Speed 4000
+#       -RTTChannel 2 trace.bin
+# Parquet output needs pandas and pyarrow.
+SYNC = 0xA5
+REC = struct.Struct('<BBHIHHHH')  # sync, type, seq, time_us, a, b, c, d
+
+# Field names per record type, a leading '-' marks a signed field
+TYPES = {
+    1: ('bus_rx', ('node', 'func', 'value', None)),
+    2: ('bus_err', ('-error', None, None, None)),
+    3: ('tgt_rx', ('-incline', 'resistance', 'power', None)),
+    4: ('tgt_issued', ('actuator', '-target', 'received', 'issued')),
+    5: ('notify', ('uuid', 'conn', '-result', 'length')),
+    6: ('loop', ('exec_ms', 'poll_ms', None, None)),
+    7: ('rider_tgt', ('actuator', 'target', None, None)),
+    8: ('bus_tx', ('node', 'func', 'address', 'value')),
+}
+COLUMNS = ['time_us', 'seq', 'type'] + sorted({
+    f.lstrip('-') for _, fields in TYPES.values() for f in fields if f})
+
+def records ( data ):
+    pos = 0
+    lastSeq = None
+    lastTime = 0
+    wrap = 0
+    gaps = 0
+    while pos + REC.size <= len(data):
+        sync, kind, seq, time, *args = REC.unpack_from(data, pos)
+        if sync != SYNC or kind not in TYPES:
+            pos += 1  # Resync, capture started mid record
+            continue
+        pos += REC.size
+
+        if lastSeq is not None and seq != (lastSeq + 1) & 0xFFFF:
+            gaps += (seq - lastSeq - 1) & 0xFFFF
+        lastSeq = seq
+        # Only a big step back is a wrap, not records slightly out of order
+        if lastTime - time > 1 << 31:
+            wrap += 1 << 32
+        lastTime = time
+
+        name, fields = TYPES[kind]
+        row = {'time_us': time + wrap, 'seq': seq, 'type': name}
+        for field, value in zip(fields, args):
+            if field and field.startswith('-'):
+                row[field[1:]] = value - 0x10000 if value & 0x8000 else value
+            elif field:
+                row[field] = value
+        yield row
+    print('%d records skipped on the bike' % gaps, file = sys.stderr)
+
+if __name__ == '__main__':
+    with open(sys.argv[1], 'rb') as f:
+        rows = list(records(f.read()))
+    output = sys.argv[2]
+    if output.endswith('.parquet'):
+        import pandas
+        pandas.DataFrame(rows, columns = COLUMNS).to_parquet(output)
+    else:
+        with open(output, 'w', newline = '') as f:
+            writer = csv.DictWriter(f, COLUMNS)
+            writer.writeheader()
+            writer.writerows(rows)
+    print('%d records written to %s' % (len(rows), output))